@@ -26,6 +26,7 @@
 # include "data.h"
 # include "interpret.h"
 # include "call_out.h"
+# include "metrics.h"
 
 # define CYCBUF_SIZE	128		/* cyclic buffer size, power of 2 */
 # define CYCBUF_MASK	(CYCBUF_SIZE - 1) /* cyclic buffer mask */
@@ -543,6 +544,15 @@ void CallOut::list(Array *a)
     }
 }
 
+/*
+ * return the number of milliseconds from due to time
+ */
+static Uint lag(Time due, Time time)
+{
+    return ((Uint) (time >> 16) - (Uint) (due >> 16)) * 1000 +
+	   (Uint) (time & 0xffff) - (Uint) (due & 0xffff);
+}
+
 /*
  * collect callouts to run next
  */
@@ -565,6 +575,7 @@ void CallOut::expire()
 	     * from queue
 	     */
 	    while (queuebrk != 0 && (Uint) (cotab[0].time >> 16) < timestamp) {
+		Metrics::calloutLag(lag(cotab[0].time, time), 1);
 		handle = cotab[0].handle;
 		oindex = cotab[0].oindex;
 		dequeue(0);
@@ -580,6 +591,8 @@ void CallOut::expire()
 	    i = *cyc;
 	    if (i != 0) {
 		*cyc = 0;
+		Metrics::calloutLag(lag((Time) timestamp << 16, time),
+				    cotab[i].r.count);
 		if (immediate == 0) {
 		    immediate = i;
 		} else {
@@ -599,6 +612,7 @@ void CallOut::expire()
 	 * from queue
 	 */
 	while (queuebrk != 0 && cotab[0].time <= time) {
+	    Metrics::calloutLag(lag(cotab[0].time, time), 1);
 	    handle = cotab[0].handle;
 	    oindex = cotab[0].oindex;
 	    dequeue(0);
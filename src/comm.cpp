@@ -26,6 +26,7 @@
 # include "data.h"
 # include "interpret.h"
 # include "comm.h"
+# include "metrics.h"
 # include "version.h"
 # include <errno.h>
 
@@ -48,12 +49,13 @@ public:
     void del(Frame *f, Object *obj, bool destruct);
     int write(Object *obj, String *str, char *text, unsigned int len);
     void uflush(Object *obj, Dataspace *data, Array *arr);
+    void watch();
 
     static User *create(Frame *f, Object *obj, Connection *conn, int flags);
 
     uindex oindex;		/* associated object index */
-    User *prev;			/* preceding user */
-    User *next;			/* next user */
+    User *prev;			/* preceding busy user */
+    User *next;			/* next busy or free user */
     User *flush;		/* next in flush list */
     short flags;		/* connection flags */
     char state;			/* telnet state */
@@ -64,6 +66,7 @@ public:
     String *outbuf;		/* output buffer string */
     ssizet inbufsz;		/* bytes in input buffer */
     ssizet osdone;		/* bytes of output string done */
+    short port;			/* port slot for metrics */
 };
 
 /* flags */
@@ -79,6 +82,8 @@ public:
 # define CF_OUTPUT	0x0040	/* pending output */
 # define CF_ODONE	0x0080	/* output done */
 # define CF_OPENDING	0x0100	/* waiting for connect() to complete */
+# define CF_READY	0x0200	/* in ready list */
+# define CF_BUSY	0x0400	/* in busy list */
 
 /* state */
 # define TS_DATA	0
@@ -92,7 +97,10 @@ public:
 # define TS_SE		8
 
 static User *users;		/* array of users */
-static User *lastuser;		/* last user checked */
+static User *busy;		/* users to visit every turn */
+static User **ready;		/* users to visit this turn */
+static Connection **rconn;	/* connections with activity */
+static int nextuser;		/* user to visit first */
 static User *freeuser;		/* linked list of free users */
 static User *flush;		/* flush list */
 static int nusers;		/* # of users */
@@ -120,20 +128,14 @@ User *User::create(Frame *f, Object *obj, Connection *conn, int flags)
 
     usr = freeuser;
     freeuser = usr->next;
-    if (lastuser != (User *) NULL) {
-	usr->prev = lastuser->prev;
-	usr->prev->next = usr;
-	usr->next = lastuser;
-	lastuser->prev = usr;
-    } else {
-	usr->prev = usr;
-	usr->next = usr;
-	lastuser = usr;
-    }
 
     arr = usr->setup(f, obj);
     usr->conn = conn;
+    if (conn != (Connection *) NULL) {
+	conn->user = usr;
+    }
     usr->flags = flags;
+    usr->port = Metrics::port(MP_BINARY, -1);
     if (flags & CF_TELNET) {
 	/* initialize connection */
 	usr->flags = CF_TELNET | CF_ECHO | CF_OUTPUT;
@@ -150,6 +152,7 @@ User *User::create(Frame *f, Object *obj, Connection *conn, int flags)
 	obj->data->assignElt(arr, &arr->elts[1], &val);
     }
     nusers++;
+    usr->watch();
 
     return usr;
 }
@@ -314,6 +317,7 @@ void User::uflush(Object *obj, Dataspace *data, Array *arr)
 	    n = conn->write(v[1].string->text + osdone,
 			    v[1].string->len - osdone);
 	    if (n >= 0) {
+		Metrics::output(port, n);
 		n += osdone;
 		if (n == v[1].string->len) {
 		    /* buffer fully drained */
@@ -337,6 +341,7 @@ void User::uflush(Object *obj, Dataspace *data, Array *arr)
     if (v[2].type == T_STRING) {
 	if (flags & CF_UDPDATA) {
 	    conn->writeUdp(v[2].string->text, v[2].string->len);
+	    Metrics::output(port, v[2].string->len);
 	} else if (conn->udp(v[2].string->text, v[2].string->len)) {
 	    flags |= CF_UDP;
 	}
@@ -344,6 +349,45 @@ void User::uflush(Object *obj, Dataspace *data, Array *arr)
     }
 }
 
+/*
+ * keep the user in the busy list while it needs a visit every turn,
+ * regardless of activity on its connection
+ */
+void User::watch()
+{
+    bool visit;
+
+    if (oindex == OBJ_NONE) {
+	visit = FALSE;
+    } else if (flags & CF_TELNET) {
+	visit = ((flags & (CF_ODONE | CF_OPENDING)) || newlines != 0);
+    } else {
+	visit = ((flags & (CF_ODONE | CF_OPENDING | CF_UDP | CF_UDPDATA)) != 0);
+    }
+
+    if (visit) {
+	if (!(flags & CF_BUSY)) {
+	    flags |= CF_BUSY;
+	    prev = (User *) NULL;
+	    next = busy;
+	    if (busy != (User *) NULL) {
+		busy->prev = this;
+	    }
+	    busy = this;
+	}
+    } else if (flags & CF_BUSY) {
+	flags &= ~CF_BUSY;
+	if (prev != (User *) NULL) {
+	    prev->next = next;
+	} else {
+	    busy = next;
+	}
+	if (next != (User *) NULL) {
+	    next->prev = prev;
+	}
+    }
+}
+
 
 static User *outbound;		/* pending outbound list */
 static int maxusers;		/* max # of users */
@@ -378,9 +422,12 @@ bool Comm::init(int n, int p, char **thosts, char **bhosts, char **dhosts,
 	usr->next = usr + 1;
     }
     users[n - 1].next = (User *) NULL;
+    ready = ALLOC(User*, n);
+    rconn = ALLOC(Connection*, n);
 
     freeuser = usr;
-    lastuser = (User *) NULL;
+    busy = (User *) NULL;
+    nextuser = 0;
     ::flush = outbound = (User *) NULL;
     nusers = odone = newlines = 0;
     this_user = OBJ_NONE;
@@ -549,6 +596,66 @@ void Comm::challenge(Object *obj, String *str)
     data->assignElt(arr, v, &val);
 }
 
+# define BYTES(c)	((Uuint) -1 / 0xff * (c))	/* c in every byte */
+# define HASZERO(w)	(((w) - BYTES(0x01)) & ~(w) & BYTES(0x80))
+
+/*
+ * copy text up to the first IAC or LF, a word at a time, and return the
+ * number of bytes copied
+ */
+static unsigned int copyOutput(char *to, const char *from, unsigned int len)
+{
+    Uuint w;
+    unsigned int n;
+
+    for (n = 0; n + sizeof(Uuint) <= len; n += sizeof(Uuint)) {
+	memcpy(&w, from + n, sizeof(Uuint));
+	if (HASZERO(~w) | HASZERO(w ^ BYTES(LF))) {
+	    break;
+	}
+	memcpy(to + n, &w, sizeof(Uuint));
+    }
+    while (n < len && UCHAR(from[n]) != IAC && from[n] != LF) {
+	to[n] = from[n];
+	n++;
+    }
+    return n;
+}
+
+/*
+ * copy telnet input up to the first byte that needs processing, a word
+ * at a time, and return the number of bytes copied
+ */
+static unsigned int copyInput(char *to, const char *from, unsigned int len)
+{
+    Uuint w;
+    unsigned int n;
+
+    for (n = 0; n + sizeof(Uuint) <= len; n += sizeof(Uuint)) {
+	memcpy(&w, from + n, sizeof(Uuint));
+	if (HASZERO(w) | HASZERO(~w) | HASZERO(w ^ BYTES(CR)) |
+	    HASZERO(w ^ BYTES(LF)) | HASZERO(w ^ BYTES(BS)) |
+	    HASZERO(w ^ BYTES(0x7f))) {
+	    break;
+	}
+	memcpy(to + n, &w, sizeof(Uuint));
+    }
+    while (n < len) {
+	switch (UCHAR(from[n])) {
+	case '\0':
+	case BS:
+	case LF:
+	case CR:
+	case 0x7f:
+	case IAC:
+	    return n;
+	}
+	to[n] = from[n];
+	n++;
+    }
+    return n;
+}
+
 /*
  * send a message to a user
  */
@@ -560,7 +667,7 @@ int Comm::send(Object *obj, String *str)
     if (usr->flags & CF_TELNET) {
 	char outbuf[OUTBUF_SIZE];
 	char *p, *q;
-	unsigned int len, size, n;
+	unsigned int len, size, n, run;
 
 	/*
 	 * telnet connection
@@ -568,7 +675,7 @@ int Comm::send(Object *obj, String *str)
 	p = str->text;
 	len = str->len;
 	q = outbuf;
-	size = 0;
+	size = run = 0;
 	for (;;) {
 	    if (len == 0 || size >= OUTBUF_SIZE - 1 || UCHAR(*p) == IAC) {
 		n = usr->write(obj, (String *) NULL, outbuf, size);
@@ -611,6 +718,18 @@ int Comm::send(Object *obj, String *str)
 		 */
 		*q++ = CR;
 		size++;
+	    } else if (++run >= sizeof(Uuint)) {
+		/*
+		 * plain text: copy the rest of the run in bulk
+		 */
+		run = 0;
+		n = copyOutput(q, p, (len < OUTBUF_SIZE - 1 - size) ?
+				     len : OUTBUF_SIZE - 1 - size);
+		p += n;
+		q += n;
+		len -= n;
+		size += n;
+		continue;
 	    }
 	    *q++ = *p++;
 	    --len;
@@ -743,11 +862,13 @@ void Comm::flush()
 	    if (usr->conn == (Connection *) NULL) {
 		EC->fatal("can't connect to server");
 	    }
+	    usr->conn->user = usr;
 
 	    obj->data->assignElt(arr, &arr->elts[0], &Value::zeroInt);
 	    obj->data->assignElt(arr, &arr->elts[1], &Value::nil);
 	    arr->del();
 	    usr->flags &= ~CF_FLUSH;
+	    usr->watch();
 	} else {
 	    /* discard */
 	    usr->flush = ::flush;
@@ -823,15 +944,7 @@ void Comm::flush()
 	    }
 
 	    usr->oindex = OBJ_NONE;
-	    if (usr->next == usr) {
-		lastuser = (User *) NULL;
-	    } else {
-		usr->next->prev = usr->prev;
-		usr->prev->next = usr->next;
-		if (usr == lastuser) {
-		    lastuser = usr->next;
-		}
-	    }
+	    usr->watch();
 	    usr->next = freeuser;
 	    freeuser = usr;
 	    if ((usr->flags & (CF_TELNET | CF_UDP | CF_UDPDATA)) == CF_UDPDATA)
@@ -843,6 +956,7 @@ void Comm::flush()
 
 	arr->del();
 	usr->flags &= ~CF_FLUSH;
+	usr->watch();
     }
 }
 
@@ -864,6 +978,7 @@ void Comm::acceptTelnet(Frame *f, Connection *conn, int port)
 	obj = OBJ(f->sp->oindex);
 	f->sp++;
 	usr = User::create(f, obj, conn, CF_TELNET);
+	usr->port = Metrics::port(MP_TELNET, port);
 	EC->pop();
     } catch (...) {
 	conn->del();		/* delete connection */
@@ -885,6 +1000,7 @@ void Comm::acceptTelnet(Frame *f, Connection *conn, int port)
  */
 void Comm::accept(Frame *f, Connection *conn, int port)
 {
+    User *usr;
     Object *obj;
 
     try {
@@ -896,7 +1012,8 @@ void Comm::accept(Frame *f, Connection *conn, int port)
 	}
 	obj = OBJ(f->sp->oindex);
 	f->sp++;
-	User::create(f, obj, conn, 0);
+	usr = User::create(f, obj, conn, 0);
+	usr->port = Metrics::port(MP_BINARY, port);
 	EC->pop();
     } catch (...) {
 	conn->del();		/* delete connection */
@@ -916,6 +1033,7 @@ void Comm::accept(Frame *f, Connection *conn, int port)
  */
 void Comm::acceptDgram(Frame *f, Connection *conn, int port)
 {
+    User *usr;
     Object *obj;
 
     try {
@@ -927,7 +1045,8 @@ void Comm::acceptDgram(Frame *f, Connection *conn, int port)
 	}
 	obj = OBJ(f->sp->oindex);
 	f->sp++;
-	User::create(f, obj, conn, CF_UDPDATA);
+	usr = User::create(f, obj, conn, CF_UDPDATA);
+	usr->port = Metrics::port(MP_DGRAM, port);
 	ndgram++;
 	EC->pop();
     } catch (...) {
@@ -943,6 +1062,51 @@ void Comm::acceptDgram(Frame *f, Connection *conn, int port)
     this_user = OBJ_NONE;
 }
 
+/*
+ * compare two users by their position in the user table
+ */
+static int cmp(cvoid *cv1, cvoid *cv2)
+{
+    return (*(User **) cv1 < *(User **) cv2) ? -1 : 1;
+}
+
+/*
+ * collect the users to visit this turn: those with activity on their
+ * connection and those in the busy list, in user table order starting
+ * with the user after the one last visited
+ */
+static int gather(int *start)
+{
+    User *usr;
+    int n, i;
+
+    n = 0;
+    for (i = Connection::ready(rconn); i > 0; ) {
+	usr = rconn[--i]->user;
+	if (usr != (User *) NULL && usr->conn == rconn[i] &&
+	    usr->oindex != OBJ_NONE && !(usr->flags & CF_READY)) {
+	    usr->flags |= CF_READY;
+	    ready[n++] = usr;
+	}
+    }
+    for (usr = busy; usr != (User *) NULL; usr = usr->next) {
+	if (!(usr->flags & CF_READY)) {
+	    usr->flags |= CF_READY;
+	    ready[n++] = usr;
+	}
+    }
+    qsort(ready, n, sizeof(User *), cmp);
+    *start = 0;
+    for (i = n; i > 0; ) {
+	usr = ready[--i];
+	usr->flags &= ~CF_READY;
+	if (usr - users >= nextuser) {
+	    *start = i;
+	}
+    }
+    return n;
+}
+
 /*
  * receive a message from a user
  */
@@ -959,14 +1123,16 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
     char buffer[BINBUF_SIZE];
     Object *obj;
     User *usr;
-    int n, i, state, nls;
+    int n, i, nready, start, state, nls, run, plain;
     char *p, *q;
     Connection *conn;
 
     if (newlines != 0 || odone != 0) {
 	timeout = mtime = 0;
     }
+    Metrics::idle();
     n = Connection::select(timeout, mtime);
+    Metrics::startTask();
     if ((n <= 0) && (newlines == 0) && (odone == 0)) {
 	/*
 	 * call_out to do, or timeout
@@ -974,25 +1140,31 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 	return;
     }
 
+    nready = 0;
     try {
 	EC->push(DGD::errHandler);
 	if (ntport != 0 && nusers < maxusers) {
 	    n = nexttport;
 	    do {
 		/*
-		 * accept new telnet connection
+		 * accept new telnet connections, draining the listen queue
+		 * up to MAXACCEPT at a time
 		 */
-		conn = Connection::createTelnet6(n);
-		if (conn != (Connection *) NULL) {
+		for (i = MAXACCEPT; i > 0 && nusers < maxusers; --i) {
+		    conn = Connection::createTelnet6(n);
+		    if (conn == (Connection *) NULL) {
+			break;
+		    }
 		    acceptTelnet(f, conn, n);
 		    nexttport = (n + 1) % ntport;
 		}
-		if (nusers < maxusers) {
+		for (i = MAXACCEPT; i > 0 && nusers < maxusers; --i) {
 		    conn = Connection::createTelnet(n);
-		    if (conn != (Connection *) NULL) {
-			acceptTelnet(f, conn, n);
-			nexttport = (n + 1) % ntport;
+		    if (conn == (Connection *) NULL) {
+			break;
 		    }
+		    acceptTelnet(f, conn, n);
+		    nexttport = (n + 1) % ntport;
 		}
 
 		n = (n + 1) % ntport;
@@ -1003,17 +1175,21 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 	    n = nextbport;
 	    do {
 		/*
-		 * accept new binary connection
+		 * accept new binary connections
 		 */
-		conn = Connection::create6(n);
-		if (conn != (Connection *) NULL) {
+		for (i = MAXACCEPT; i > 0 && nusers < maxusers; --i) {
+		    conn = Connection::create6(n);
+		    if (conn == (Connection *) NULL) {
+			break;
+		    }
 		    accept(f, conn, n);
 		}
-		if (nusers < maxusers) {
+		for (i = MAXACCEPT; i > 0 && nusers < maxusers; --i) {
 		    conn = Connection::create(n);
-		    if (conn != (Connection *) NULL) {
-			accept(f, conn, n);
+		    if (conn == (Connection *) NULL) {
+			break;
 		    }
+		    accept(f, conn, n);
 		}
 		n = (n + 1) % nbport;
 		if (nusers == maxusers) {
@@ -1047,13 +1223,16 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 	    } while (n != nextdport);
 	}
 
-	for (i = nusers; lastuser != (User *) NULL && i > 0; --i) {
-	    usr = lastuser;
-	    lastuser = usr->next;
+	nready = gather(&start);
+	for (i = 0; i < nready; i++) {
+	    usr = ready[(start + i) % nready];
+	    if (usr->oindex == OBJ_NONE) {
+		continue;	/* closed during this turn */
+	    }
+	    nextuser = usr - users + 1;
 
 	    obj = OBJ(usr->oindex);
 
-
 	    /*
 	     * Check if we have an event pending from connect() and if so,
 	     * handle it.
@@ -1134,7 +1313,9 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 		if (usr->inbufsz != INBUF_SIZE) {
 		    p = usr->inbuf + usr->inbufsz;
 		    n = usr->conn->read(p, INBUF_SIZE - usr->inbufsz);
-		    if (n < 0) {
+		    if (n > 0) {
+			Metrics::input(usr->port, n);
+		    } else if (n < 0) {
 			if (usr->inbufsz != 0) {
 			    if (p[-1] != LF) {
 				/*
@@ -1156,9 +1337,23 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 		    state = usr->state;
 		    nls = usr->newlines;
 		    q = p;
+		    run = 0;
 		    while (n > 0) {
 			switch (state) {
 			case TS_DATA:
+			    if (run >= (int) sizeof(Uuint)) {
+				/*
+				 * plain text: copy the rest of the run in bulk
+				 */
+				run = 0;
+				plain = copyInput(q, p, n);
+				if (plain != 0) {
+				    p += plain;
+				    q += plain;
+				    n -= plain;
+				    continue;
+				}
+			    }
 			    switch (UCHAR(*p)) {
 			    case IAC:
 				state = TS_IAC;
@@ -1184,6 +1379,7 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 				/* fall through */
 			    default:
 				*q++ = *p;
+				run++;
 				/* fall through */
 			    case '\0':
 				break;
@@ -1360,6 +1556,7 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 			/*
 			 * received datagram
 			 */
+			Metrics::input(usr->port, n);
 			PUSH_STRVAL(f, String::create(buffer, n));
 			this_user = obj->index;
 			if (f->call(obj, (Array *) NULL, "receive_datagram", 16,
@@ -1396,6 +1593,7 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
 		    continue;
 		}
 
+		Metrics::input(usr->port, n);
 		PUSH_STRVAL(f, String::create(buffer, n));
 	    }
 
@@ -1412,9 +1610,15 @@ void Comm::receive(Frame *f, Uint timeout, unsigned int mtime)
     } catch (...) {
 	DGD::endTask();
 	this_user = OBJ_NONE;
+	for (i = 0; i < nready; i++) {
+	    ready[i]->watch();
+	}
 	return;
     }
 
+    for (i = 0; i < nready; i++) {
+	ready[i]->watch();
+    }
     flush();
 }
 
@@ -1720,23 +1924,17 @@ bool Comm::restore(int fd)
 	    /* allocate user */
 	    usr = freeuser;
 	    freeuser = usr->next;
-	    if (lastuser != (User *) NULL) {
-		usr->prev = lastuser->prev;
-		usr->prev->next = usr;
-		usr->next = lastuser;
-		lastuser->prev = usr;
-	    } else {
-		usr->prev = usr;
-		usr->next = usr;
-		lastuser = usr;
-	    }
 	    nusers++;
 
 	    /* initialize user */
 	    usr->oindex = du->oindex;
 	    OBJ(usr->oindex)->etabi = usr - users;
 	    OBJ(usr->oindex)->flags |= O_USER;
-	    usr->flags = du->flags;
+	    usr->flags = du->flags & ~CF_BUSY;
+	    usr->port = Metrics::port((usr->flags & CF_TELNET) ? MP_TELNET :
+				       (usr->flags & CF_UDPDATA) ? MP_DGRAM :
+								   MP_BINARY,
+				      du->at);
 	    if (usr->flags & CF_ODONE) {
 		odone++;
 	    }
@@ -1744,6 +1942,7 @@ bool Comm::restore(int fd)
 	    usr->newlines = du->newlines;
 	    newlines += usr->newlines;
 	    usr->conn = conn;
+	    conn->user = usr;
 	    if (usr->flags & CF_TELNET) {
 		MM->staticMode();
 		usr->inbuf = ALLOC(char, INBUF_SIZE + 1);
@@ -1760,6 +1959,7 @@ bool Comm::restore(int fd)
 		tbuf += usr->inbufsz;
 	    }
 	    usr->osdone = du->osdone;
+	    usr->watch();
 
 	    du++;
 	}
@@ -21,6 +21,8 @@
 # define  P_UDP      17
 # define  P_TELNET   1
 
+class User;
+
 class Connection {
 public:
     virtual bool attach() = 0;
@@ -47,6 +49,7 @@ public:
     static void finish();
     static void listen();
     static int select(Uint t, unsigned int mtime);
+    static int ready(Connection **list);
     static void *host(char *addr, unsigned short port, int *len);
     static int fdcount();
     static void fdlist(int *list);
@@ -63,6 +66,8 @@ public:
     static Connection *import(int fd, char *addr, unsigned short port, short at,
 			      int npkts, int bufsz, char *buf, char flags,
 			      bool telnet);
+
+    User *user;			/* user of this connection */
 };
 
 class Comm {
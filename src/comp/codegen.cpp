@@ -29,6 +29,7 @@
 # include "node.h"
 # include "codegen.h"
 # include "compile.h"
+# include "hash.h"
 
 # define LINE_CHUNK	128
 
@@ -162,10 +163,13 @@ public:
     static void instr(int i, unsigned short line);
     static void kfun(int kf, unsigned short line);
     static void ckfun(int kf, unsigned short line);
+    static void jump(int kf, bool jmptrue, unsigned short line);
     static char *make(unsigned short depth, int nlocals, unsigned short *size);
     static void clear();
 
 private:
+    static bool inlineOp(int kf);
+
     CodeChunk *next;			/* next in list */
     char code[CODE_CHUNK];		/* chunk of code */
 };
@@ -223,12 +227,66 @@ void CodeChunk::instr(int i, unsigned short line)
     last_instruction = &tcode->code[cchunksz - 1];
 }
 
+/*
+ * check whether a builtin kfun is a typed operator that the interpreter
+ * performs inline
+ */
+bool CodeChunk::inlineOp(int kf)
+{
+    switch (kf) {
+    case KF_ADD_INT:
+    case KF_ADD1_INT:
+    case KF_AND_INT:
+    case KF_DIV_INT:
+    case KF_EQ_INT:
+    case KF_GE_INT:
+    case KF_GT_INT:
+    case KF_LE_INT:
+    case KF_LSHIFT_INT:
+    case KF_LT_INT:
+    case KF_MOD_INT:
+    case KF_MULT_INT:
+    case KF_NE_INT:
+    case KF_NEG_INT:
+    case KF_NOT_INT:
+    case KF_OR_INT:
+    case KF_RSHIFT_INT:
+    case KF_SUB_INT:
+    case KF_SUB1_INT:
+    case KF_TST_INT:
+    case KF_UMIN_INT:
+    case KF_XOR_INT:
+    case KF_ADD_FLT:
+    case KF_ADD1_FLT:
+    case KF_DIV_FLT:
+    case KF_EQ_FLT:
+    case KF_GE_FLT:
+    case KF_GT_FLT:
+    case KF_LE_FLT:
+    case KF_LT_FLT:
+    case KF_MULT_FLT:
+    case KF_NE_FLT:
+    case KF_NOT_FLT:
+    case KF_SUB_FLT:
+    case KF_SUB1_FLT:
+    case KF_TST_FLT:
+    case KF_UMIN_FLT:
+	return TRUE;
+
+    default:
+	return FALSE;
+    }
+}
+
 /*
  * generate code for a builtin kfun
  */
 void CodeChunk::kfun(int kf, unsigned short line)
 {
-    if (kf < 256) {
+    if (inlineOp(kf)) {
+	instr(I_OPERATOR, line);
+	byte(kf);
+    } else if (kf < 256) {
 	instr(I_CALL_KFUNC, line);
 	byte(kf);
     } else {
@@ -251,6 +309,33 @@ void CodeChunk::ckfun(int kf, unsigned short line)
     }
 }
 
+/*
+ * generate code for a typed comparison followed by a conditional jump; the
+ * jump address must be added by the caller
+ */
+void CodeChunk::jump(int kf, bool jmptrue, unsigned short line)
+{
+    if (jmptrue) {
+	/* jump if the inverse comparison is false */
+	switch (kf) {
+	case KF_EQ_INT:	kf = KF_NE_INT; break;
+	case KF_NE_INT:	kf = KF_EQ_INT; break;
+	case KF_LT_INT:	kf = KF_GE_INT; break;
+	case KF_GE_INT:	kf = KF_LT_INT; break;
+	case KF_GT_INT:	kf = KF_LE_INT; break;
+	case KF_LE_INT:	kf = KF_GT_INT; break;
+	case KF_EQ_FLT:	kf = KF_NE_FLT; break;
+	case KF_NE_FLT:	kf = KF_EQ_FLT; break;
+	case KF_LT_FLT:	kf = KF_GE_FLT; break;
+	case KF_GE_FLT:	kf = KF_LT_FLT; break;
+	case KF_GT_FLT:	kf = KF_LE_FLT; break;
+	case KF_LE_FLT:	kf = KF_GT_FLT; break;
+	}
+    }
+    instr(I_OPERATOR, line);
+    byte(kf | I_OP_JUMP);
+}
+
 /*
  * create function code block
  */
@@ -1223,6 +1308,15 @@ void Codegen::expr(Node *n, int pop)
 	break;
 
     case N_INDEX:
+	if (n->l.left->type == N_LOCAL && n->r.right->type == N_INT &&
+	    n->r.right->l.number >= -128 && n->r.right->l.number <= 127) {
+	    /* index local variable with small constant */
+	    CodeChunk::instr(I_OPERATOR, n->line);
+	    CodeChunk::byte(I_OP_LOCAL_INDEX);
+	    CodeChunk::byte(nparams - (int) n->l.left->r.number - 1);
+	    CodeChunk::byte((int) n->r.right->l.number);
+	    break;
+	}
 	expr(n->l.left, FALSE);
 	expr(n->r.right, FALSE);
 	CodeChunk::instr(I_INDEX, n->line);
@@ -1789,6 +1883,27 @@ void Codegen::expr(Node *n, int pop)
     }
 }
 
+/*
+ * return the kfun for a typed comparison
+ */
+int Codegen::compare(int type)
+{
+    switch (type) {
+    case N_EQ_INT:	return KF_EQ_INT;
+    case N_EQ_FLOAT:	return KF_EQ_FLT;
+    case N_GE_INT:	return KF_GE_INT;
+    case N_GE_FLOAT:	return KF_GE_FLT;
+    case N_GT_INT:	return KF_GT_INT;
+    case N_GT_FLOAT:	return KF_GT_FLT;
+    case N_LE_INT:	return KF_LE_INT;
+    case N_LE_FLOAT:	return KF_LE_FLT;
+    case N_LT_INT:	return KF_LT_INT;
+    case N_LT_FLOAT:	return KF_LT_FLT;
+    case N_NE_INT:	return KF_NE_INT;
+    default:		return KF_NE_FLT;
+    }
+}
+
 /*
  * generate code for a condition
  */
@@ -1851,6 +1966,46 @@ void Codegen::cond(Node *n, int jmptrue)
 	    n = n->r.right;
 	    continue;
 
+	case N_EQ_INT:
+	case N_EQ_FLOAT:
+	case N_GE_INT:
+	case N_GE_FLOAT:
+	case N_GT_INT:
+	case N_GT_FLOAT:
+	case N_LE_INT:
+	case N_LE_FLOAT:
+	case N_LT_INT:
+	case N_LT_FLOAT:
+	case N_NE_INT:
+	case N_NE_FLOAT:
+	    /*
+	     * compare and jump in a single instruction
+	     */
+	    expr(n->l.left, FALSE);
+	    expr(n->r.right, FALSE);
+	    CodeChunk::jump(compare(n->type), jmptrue, n->line);
+	    if (jmptrue) {
+		true_list = JmpList::addr(true_list);
+	    } else {
+		false_list = JmpList::addr(false_list);
+	    }
+	    break;
+
+	case N_LOCAL:
+	    /*
+	     * test local variable and jump in a single instruction
+	     */
+	    CodeChunk::instr(I_OPERATOR, n->line);
+	    CodeChunk::byte(((jmptrue) ? I_OP_NOT_LOCAL : I_OP_LOCAL) |
+			    I_OP_JUMP);
+	    CodeChunk::byte(nparams - (int) n->r.number - 1);
+	    if (jmptrue) {
+		true_list = JmpList::addr(true_list);
+	    } else {
+		false_list = JmpList::addr(false_list);
+	    }
+	    break;
+
 	default:
 	    expr(n, FALSE);
 	    if (jmptrue) {
@@ -2062,17 +2217,114 @@ void Codegen::switchRange(Node *n)
     switch_table = table;
 }
 
+/*
+ * find a perfect hash for the n string labels starting at m: the
+ * labels are distributed over buckets, and each bucket gets a seed
+ * that maps its labels to free slots in the table
+ */
+bool Codegen::switchHash(Node *m, int n, int *rbits, int *mbits,
+			 char **seeds, unsigned short **slots)
+{
+    Uint *hash;
+    int *first, *next, *count;
+    int i, j, k, b, d, r, size, max;
+    String *str;
+
+    hash = ALLOC(Uint, n);
+    next = ALLOC(int, n);
+    for (i = 0; i < n; i++) {
+	str = m->l.left->l.string;
+	hash[i] = Hashtab::hashkey(str->text, str->len);
+	m = m->r.right;
+    }
+
+    for (*mbits = 1; (1 << *mbits) < n; (*mbits)++) ;
+    for (max = *mbits + 2; *mbits <= max; (*mbits)++) {
+	*rbits = *mbits - 1;
+	r = 1 << *rbits;
+	size = 1 << *mbits;
+
+	/* distribute labels over buckets */
+	first = ALLOC(int, r);
+	count = ALLOC(int, r);
+	for (b = 0; b < r; b++) {
+	    first[b] = -1;
+	    count[b] = 0;
+	}
+	k = 0;
+	for (i = 0; i < n; i++) {
+	    b = hash[i] & (r - 1);
+	    next[i] = first[b];
+	    first[b] = i;
+	    if (++count[b] > k) {
+		k = count[b];
+	    }
+	}
+	*seeds = ALLOC(char, r);
+	memset(*seeds, '\0', r);
+	*slots = ALLOC(unsigned short, size);
+	memset(*slots, '\0', size * sizeof(unsigned short));
+
+	/* place buckets, largest first */
+	for (; k > 0; --k) {
+	    for (b = 0; b < r; b++) {
+		if (count[b] != k) {
+		    continue;
+		}
+		for (d = 0; d < 256; d++) {
+		    for (i = first[b]; i >= 0; i = next[i]) {
+			j = SWITCH_SLOT(hash[i], d, *mbits);
+			if ((*slots)[j] != 0) {
+			    break;
+			}
+			(*slots)[j] = i + 1;
+		    }
+		    if (i < 0) {
+			break;	/* all labels placed */
+		    }
+		    for (j = first[b]; j != i; j = next[j]) {
+			(*slots)[SWITCH_SLOT(hash[j], d, *mbits)] = 0;
+		    }
+		}
+		if (d == 256) {
+		    break;
+		}
+		(*seeds)[b] = d;
+	    }
+	    if (b < r) {
+		break;	/* failed */
+	    }
+	}
+
+	FREE(count);
+	FREE(first);
+	if (k == 0) {
+	    FREE(next);
+	    FREE(hash);
+	    return TRUE;
+	}
+	FREE(*slots);
+	FREE(*seeds);
+    }
+
+    FREE(next);
+    FREE(hash);
+    return FALSE;
+}
+
 /*
  * generate code for a string switch statement
  */
 void Codegen::switchStr(Node *n)
 {
     Node *m;
-    int i, size;
+    int i, size, rbits, mbits;
+    char *seeds;
+    unsigned short *slots;
+    bool hashed;
     case_label *table;
 
     switchStart(n);
-    CodeChunk::byte(SWITCH_STRING);
     m = n->l.left;
     size = n->mod;
     if (m->l.left == (Node *) NULL) {
@@ -2082,6 +2334,15 @@ void Codegen::switchStr(Node *n)
 	/* implicit default */
 	size++;
     }
+    if (m->l.left->type == nil_node) {
+	hashed = (size - 2 >= SWITCH_HASHMIN &&
+		  switchHash(m->r.right, size - 2, &rbits, &mbits, &seeds,
+			     &slots));
+    } else {
+	hashed = (size - 1 >= SWITCH_HASHMIN &&
+		  switchHash(m, size - 1, &rbits, &mbits, &seeds, &slots));
+    }
+    CodeChunk::byte((hashed) ? SWITCH_STRHASH : SWITCH_STRING);
     CodeChunk::word(size);
 
     table = switch_table;
@@ -2108,6 +2369,21 @@ void Codegen::switchStr(Node *n)
 	switch_table[i++].jump = JmpList::addr((JmpList *) NULL);
 	m = m->r.right;
     }
+    if (hashed) {
+	/*
+	 * perfect hash table
+	 */
+	CodeChunk::byte(rbits);
+	CodeChunk::byte(mbits);
+	for (i = 0; i < 1 << rbits; i++) {
+	    CodeChunk::byte(seeds[i]);
+	}
+	for (i = 0; i < 1 << mbits; i++) {
+	    CodeChunk::word(slots[i]);
+	}
+	FREE(slots);
+	FREE(seeds);
+    }
 
     /*
      * generate code for body
@@ -41,10 +41,13 @@ private:
     static void storeargs(Node *n);
     static int math(const char *name);
     static void expr(Node *n, int pop);
+    static int compare(int type);
     static void cond(Node *n, int jmptrue);
     static void switchStart(Node *n);
     static void switchInt(Node *n);
     static void switchRange(Node *n);
+    static bool switchHash(Node *m, int n, int *rbits, int *mbits,
+			   char **seeds, unsigned short **slots);
     static void switchStr(Node *n);
     static void stmt(Node *n);
 };
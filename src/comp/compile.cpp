@@ -33,6 +33,7 @@
 # include "optimize.h"
 # include "codegen.h"
 # include "compile.h"
+# include "metrics.h"
 # include <stdarg.h>
 
 # define COND_CHUNK	16
@@ -562,6 +563,7 @@ Object *Compile::compile(Frame *f, char *file, Object *obj, String **strs,
     Context c;
     char file_c[STRINGSZ + 2];
     Control *ctrl;
+    int phase;
 
     if (iflag) {
 	Context *cc;
@@ -596,6 +598,7 @@ Object *Compile::compile(Frame *f, char *file, Object *obj, String **strs,
     c.prev = current;
     current = &c;
     ncompiled++;
+    phase = Metrics::phase(MT_COMPILE);
 
     try {
 	EC->push();
@@ -633,11 +636,11 @@ Object *Compile::compile(Frame *f, char *file, Object *obj, String **strs,
 	    }
 
 	    if (strs != (String **) NULL) {
-		PP::init(file_c, paths, strs, nstr, 1);
-	    } else if (!PP::init(file_c, paths, (String **) NULL, 0, 1)) {
+		PP::init(file_c, paths, strs, nstr, 0);
+	    } else if (!PP::init(file_c, paths, (String **) NULL, 0, 0)) {
 		EC->error("Could not compile \"/%s\"", file_c);
 	    }
-	    if (!TokenBuf::include(include, (String **) NULL, 0)) {
+	    if (!PP::include(include, (String **) NULL, 0)) {
 		EC->error("Could not include \"/%s\"", include);
 	    }
 
@@ -680,6 +683,7 @@ Object *Compile::compile(Frame *f, char *file, Object *obj, String **strs,
 	Control::clear();
 	clear();
 	current = c.prev;
+	Metrics::phase(phase);
 	EC->error((char *) NULL);
     }
 
@@ -713,6 +717,7 @@ Object *Compile::compile(Frame *f, char *file, Object *obj, String **strs,
 	    ctrl->setVarmap(vmap);
 	}
     }
+    Metrics::phase(phase);
     return obj;
 }
 
@@ -1002,6 +1007,7 @@ void Compile::funcbody(Node *n)
     if (depth > 0x7fff) {
 	error("function uses too much stack space");
     } else {
+	Control::defInline(n);
 	prog = Codegen::function(fname, n, nvars, nparams,
 				 (unsigned short) depth, &size);
 	Control::defProgram(prog, size);
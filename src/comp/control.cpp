@@ -51,6 +51,7 @@ Control::Control()
     }
     ndata = 0;
     nctrl++;
+    refs = 1;
 
     flags = 0;
     version = VERSION_VM_MINOR;
@@ -86,12 +87,24 @@ Control::Control()
     vtypes = (char *) NULL;
     vmapsize = 0;
     vmap = (unsigned short *) NULL;
+    itab = (Uint *) NULL;
 }
 
 /*
  * reference control block
  */
 void Control::ref()
+{
+    if (refs != USHRT_MAX) {
+	refs++;
+    }
+    head();
+}
+
+/*
+ * move control block to the head of the swap list
+ */
+void Control::head()
 {
     if (this != chead) {
 	/* move to head of list */
@@ -114,6 +127,7 @@ void Control::ref()
 void Control::deref()
 {
     /* swap this out first */
+    refs = 0;
     if (this != ctail) {
 	if (chead == this) {
 	    chead = next;
@@ -182,6 +196,9 @@ Control::~Control()
     if (imap != (char *) NULL) {
 	FREE(imap);
     }
+    if (itab != (Uint *) NULL) {
+	FREE(itab);
+    }
 
     /* delete string constants */
     if (sslength != (ssizet *) NULL) {
@@ -1093,6 +1110,7 @@ struct FuncInfo {
     String *cfstr;			/* function class string */
     char *prog;				/* function program */
     unsigned short progsize;		/* function program size */
+    Node *inl;				/* inlinable return value */
 };
 
 static ObjHash *newohash;		/* fake ohash entry for new object */
@@ -1395,6 +1413,7 @@ void Control::defProto(String *str, char *proto, String *sclass)
 	sclass->ref();
     }
     functions[nfdefs].progsize = 0;
+    functions[nfdefs].inl = (Node *) NULL;
     ::progsize += i;
     func = &functions[nfdefs++].func;
     func->sclass = PROTO_CLASS(proto);
@@ -1421,6 +1440,78 @@ void Control::defProgram(char *prog, unsigned int size)
     ::progsize += size;
 }
 
+/*
+ * Remember the return value of the current function, if it is a private
+ * function without arguments whose body only returns a constant or a
+ * global variable.  Calls to it can then be replaced by the value.
+ */
+void Control::defInline(Node *n)
+{
+    char *proto;
+    Node *inl;
+
+    proto = functions[fdef].proto;
+    if ((PROTO_CLASS(proto) & (C_PRIVATE | C_ATOMIC)) != C_PRIVATE ||
+	PROTO_NARGS(proto) + PROTO_VARGS(proto) != 0 ||
+	n == (Node *) NULL || n->type != N_COMPOUND ||
+	n->r.right != (Node *) NULL || n->l.left->type != N_RETURN ||
+	n->l.left->mod != 0) {
+	return;
+    }
+    n = n->l.left->l.left;
+    switch (n->type) {
+    case N_GLOBAL:
+	if (n->mod != PROTO_FTYPE(proto) || n->sclass != (String *) NULL) {
+	    return;	/* would change the type of the call */
+	}
+	break;
+
+    case N_STR:
+    case N_INT:
+    case N_FLOAT:
+    case N_NIL:
+	if (n->sclass != (String *) NULL) {
+	    return;
+	}
+	break;
+
+    default:
+	return;
+    }
+
+    inl = functions[fdef].inl = ALLOC(Node, 1);
+    *inl = *n;
+    if (inl->type == N_STR) {
+	inl->l.string->ref();
+    } else if (inl->type == N_GLOBAL) {
+	inl->l.left = (Node *) NULL;	/* name node is not kept */
+    }
+}
+
+/*
+ * replace a call to an inlinable function by a copy of its return value
+ */
+Node *Control::inlineCall(long call, unsigned short line)
+{
+    Node *inl, *n;
+
+    if ((call >> 24) != DFCALL || ((call >> 8) & 0xff) != ::ninherits) {
+	return (Node *) NULL;
+    }
+    inl = functions[call & 0xff].inl;
+    if (inl == (Node *) NULL) {
+	return (Node *) NULL;
+    }
+
+    n = Node::create(line);
+    *n = *inl;
+    n->line = line;
+    if (n->type == N_STR) {
+	n->l.string->ref();
+    }
+    return n;
+}
+
 /*
  * define a variable
  */
@@ -2174,6 +2265,12 @@ void Control::clear()
 	    if (f->cfstr != (String *) NULL) {
 		f->cfstr->del();
 	    }
+	    if (f->inl != (Node *) NULL) {
+		if (f->inl->type == N_STR) {
+		    f->inl->l.string->del();
+		}
+		FREE(f->inl);
+	    }
 	}
 	FREE(functions);
 	functions = (FuncInfo *) NULL;
@@ -3303,6 +3400,53 @@ Symbol *Control::symb(const char *func, unsigned int len)
     return (Symbol *) NULL;
 }
 
+/*
+ * find the last inherited program with the given name, or return -1
+ */
+int Control::findInherit(const char *prog, unsigned short hash)
+{
+    Uint *t, key;
+    int i, lo, hi, mid;
+
+    if (itab == (Uint *) NULL) {
+	/*
+	 * sort inherited programs by name hash, keeping the inherit index
+	 * in the low byte
+	 */
+	itab = ALLOC(Uint, ninherits);
+	for (i = 0; i < ninherits; i++) {
+	    key = ((Uint) Hashtab::hashstr(OBJR(inherits[i].oindex)->name,
+					   OBJHASHSZ) << 8) | i;
+	    for (t = itab + i; t != itab && t[-1] > key; --t) {
+		*t = t[-1];
+	    }
+	    *t = key;
+	}
+    }
+
+    /* find the last entry with this hash */
+    key = ((Uint) hash << 8) | UCHAR_MAX;
+    lo = 0;
+    hi = ninherits;
+    while (lo < hi) {
+	mid = (lo + hi) >> 1;
+	if (itab[mid] <= key) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+
+    /* entries with the same hash are ordered by inherit index */
+    for (t = itab + lo; t != itab && (t[-1] >> 8) == hash; ) {
+	i = *--t & UCHAR_MAX;
+	if (strcmp(OBJR(inherits[i].oindex)->name, prog) == 0) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
 /*
  * list the undefined functions in a program
  */
@@ -3437,3 +3581,29 @@ void Control::swapout(unsigned int frag)
 	ctrl = prev;
     }
 }
+
+/*
+ * Swap out unused control blocks until memory use is below the target.
+ * Each recent reference keeps SWAP_SECTORS sectors in memory.
+ */
+void Control::swapout()
+{
+    Sector n;
+    Control *ctrl;
+
+    for (n = nctrl; n > 1 && Dataspace::pressure(); --n) {
+	ctrl = ctail;
+	if (ctrl->ndata != 0 ||
+	    (Uint) ctrl->refs * SWAP_SECTORS > ctrl->nsectors) {
+	    ctrl->refs >>= 1;
+	    ctrl->head();
+	} else {
+	    if (ctrl->sectors == (Sector *) NULL || (ctrl->flags & CTRL_VARMAP))
+	    {
+		ctrl->save();
+	    }
+	    OBJ(ctrl->oindex)->ctrl = (Control *) NULL;
+	    delete ctrl;
+	}
+    }
+}
@@ -51,6 +51,8 @@ struct Symbol {
 
 # define DSYM_LAYOUT	"ccs"
 
+class Node;
+
 class Control : public Allocated {
 public:
     void ref();
@@ -68,6 +70,7 @@ public:
     Uint progSize();
     Symbol *symb(const char *func, unsigned int len);
     Array *undefined(Dataspace *data);
+    int findInherit(const char *prog, unsigned short hash);
 
     static void prepare();
     static bool inherit(Frame *f, char *from, Object *obj, String *label,
@@ -77,6 +80,8 @@ public:
     static void defProto(String *str, char *proto, String *sclass);
     static void defFunc(String *str, char *proto, String *sclass);
     static void defProgram(char *prog, unsigned int size);
+    static void defInline(Node *n);
+    static Node *inlineCall(long call, unsigned short line);
     static void defVar(String *str, unsigned int sclass, unsigned int type,
 		       String *cvstr);
     static char *iFunCall(String *str, const char *label, String **cfstr,
@@ -97,6 +102,7 @@ public:
     static void initConv(bool c14, bool c15, bool c16);
     static void converted();
     static void swapout(unsigned int frag);
+    static void swapout();
 
     uindex ndata;		/* # of data blocks using this control block */
 
@@ -147,6 +153,7 @@ private:
     Control();
     virtual ~Control();
 
+    void head();
     void inheritVars(class ObjHash *ohash);
     bool compareClass(Uint s1, Control *ctrl, Uint s2);
     bool compareProto(char *prot1, Control *ctrl, char *prot2);
@@ -176,6 +183,7 @@ private:
 			 void (*readv) (char*, Sector*, Uint, Uint));
 
     Control *prev, *next;
+    unsigned short refs;	/* references since last swap pass */
 
     ssizet *sslength;		/* o sstrings length */
     Uint *ssindex;		/* o sstrings index */
@@ -185,6 +193,8 @@ private:
 
     char *vtypes;		/* i/o? variable types */
 
+    Uint *itab;			/* inherits sorted by name hash */
+
     Uint progoffset;		/* o program text offset */
     Uint stroffset;		/* o offset of string index table */
     Uint funcdoffset;		/* o offset of function definition table */
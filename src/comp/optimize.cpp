@@ -1487,6 +1487,16 @@ Uint Optimize::expr(Node **m, bool pop)
 	return lvalue(n->l.left) + 1;
 
     case N_FUNC:
+	if (n->l.left->r.right == (Node *) NULL &&
+	    (n->r.number >> 24) == DFCALL) {
+	    /* attempt to inline a small private function */
+	    n = Control::inlineCall(n->r.number, n->line);
+	    if (n != (Node *) NULL) {
+		*m = n;
+		return !pop;
+	    }
+	    n = *m;
+	}
 	m = &n->l.left->r.right;
 	n = *m;
 	if (n == (Node *) NULL) {
@@ -31,6 +31,7 @@
 # include "editor.h"
 # include "call_out.h"
 # include "comm.h"
+# include "metrics.h"
 # include "ext.h"
 # include "version.h"
 # include "macro.h"
@@ -75,45 +76,58 @@ static Config conf[] = {
 # define DYNAMIC_CHUNK	12
 				{ "dynamic_chunk",	INT_CONST, FALSE, FALSE,
 							1024 },
-# define ED_TMPFILE	13
+# define ED_CACHE	13
+				{ "ed_cache",		INT_CONST, FALSE, FALSE,
+							3, USHRT_MAX },
+# define ED_TMPFILE	14
 				{ "ed_tmpfile",		STRING_CONST },
-# define EDITORS	14
+# define EDITORS	15
 				{ "editors",		INT_CONST, FALSE, FALSE,
 							0, EINDEX_MAX },
-# define HOTBOOT	15
+# define HOTBOOT	16
 				{ "hotboot",		'(' },
-# define INCLUDE_DIRS	16
+# define INCLUDE_DIRS	17
 				{ "include_dirs",	'(' },
-# define INCLUDE_FILE	17
+# define INCLUDE_FILE	18
 				{ "include_file",	STRING_CONST, TRUE },
-# define MODULES	18
+# define METRICS_FILE	19
+				{ "metrics_file",	STRING_CONST },
+# define MODULES	20
 				{ "modules",		']' },
-# define OBJECTS	19
+# define OBJECTS	21
 				{ "objects",		INT_CONST, FALSE, FALSE,
 							2, UINDEX_MAX },
-# define SECTOR_SIZE	20
+# define SECTOR_SIZE	22
 				{ "sector_size",	INT_CONST, FALSE, FALSE,
 							512, 65535 },
-# define STATIC_CHUNK	21
+# define STATIC_CHUNK	23
 				{ "static_chunk",	INT_CONST },
-# define SWAP_FILE	22
+# define SWAP_FILE	24
 				{ "swap_file",		STRING_CONST },
-# define SWAP_FRAGMENT	23
+# define SWAP_FRAGMENT	25
 				{ "swap_fragment",	INT_CONST, FALSE, FALSE,
 							0, SW_UNUSED },
-# define SWAP_SIZE	24
+# define SWAP_MEMORY	26
+				{ "swap_memory",	INT_CONST, FALSE, FALSE,
+							1, INT_MAX },
+# define SWAP_SIZE	27
 				{ "swap_size",		INT_CONST, FALSE, FALSE,
 							1024, SW_UNUSED },
-# define TELNET_PORT	25
+# define TELNET_PORT	28
 				{ "telnet_port",	'[', FALSE, FALSE,
 							1, USHRT_MAX },
-# define TYPECHECKING	26
+# define TRACE_FILE	29
+				{ "trace_file",		STRING_CONST },
+# define TRACE_THRESHOLD	30
+				{ "trace_threshold",	INT_CONST, FALSE, FALSE,
+							0, INT_MAX },
+# define TYPECHECKING	31
 				{ "typechecking",	INT_CONST, FALSE, FALSE,
 							0, 2 },
-# define USERS		27
+# define USERS		32
 				{ "users",		INT_CONST, FALSE, FALSE,
 							0, EINDEX_MAX },
-# define NR_OPTIONS	28
+# define NR_OPTIONS	33
 };
 
 
@@ -124,7 +138,7 @@ struct alignl { char fill; Uuint l;	};
 struct alignp { char fill; char *p;	};
 struct alignz { char c;			};
 
-# define FORMAT_VERSION	17
+# define FORMAT_VERSION	18
 
 # define DUMP_TYPE	4	/* first XX bytes, dump type */
 # define DUMP_HEADERSZ	28	/* header size */
@@ -303,11 +317,11 @@ void Config::dump(bool incr, bool boot)
  */
 bool Config::restore(int fd, int fd2)
 {
-    bool conv_14, conv_15, conv_16;
+    bool conv_14, conv_15, conv_16, conv_17;
     unsigned int secsize;
 
     secsize = rheader.restore(fd);
-    conv_14 = conv_15 = conv_16 = FALSE;
+    conv_14 = conv_15 = conv_16 = conv_17 = FALSE;
     if (rheader.version < 15) {
 	if (!(rheader.dflags & FLAGS_COMP159)) {
 	    EC->error("Snapshot contains legacy programs");
@@ -320,6 +334,9 @@ bool Config::restore(int fd, int fd2)
     if (rheader.version < 17) {
 	conv_16 = TRUE;
     }
+    if (rheader.version < 18) {
+	conv_17 = TRUE;
+    }
     header.version = rheader.version;
     if (memcmp(&header, &rheader, DUMP_TYPE) != 0 || rheader.zero1 != 0 ||
 	rheader.zero2 != 0 || rheader.zero3 != 0 || rheader.zero4 != 0 ||
@@ -383,7 +400,7 @@ bool Config::restore(int fd, int fd2)
     }
     rheader.psize &= 0xf;
 
-    Swap::restore(fd, secsize);
+    Swap::restore(fd, secsize, conv_17);
     KFun::restore(fd);
     Object::restore(fd, rheader.dflags & FLAGS_PARTIAL);
     Dataspace::initConv(conv_14, conv_16);
@@ -1086,7 +1103,9 @@ bool Config::config()
 
     for (l = 0; l < NR_OPTIONS; l++) {
 	if (!conf[l].set && l != HOTBOOT && l != MODULES && l != CACHE_SIZE &&
-	    l != DATAGRAM_PORT && l != DATAGRAM_USERS) {
+	    l != DATAGRAM_PORT && l != DATAGRAM_USERS && l != ED_CACHE &&
+	    l != METRICS_FILE && l != SWAP_MEMORY && l != TRACE_FILE &&
+	    l != TRACE_THRESHOLD) {
 	    char buffer[64];
 
 	    sprintf(buffer, "unspecified option %s", conf[l].name);
@@ -1541,6 +1560,16 @@ bool Config::init(char *configfile, char *snapshot, char *snapshot2,
 	return FALSE;
     }
 
+    /* initialize metrics */
+    Metrics::init((conf[METRICS_FILE].set) ?
+		   conf[METRICS_FILE].str : (char *) NULL,
+		  tports, ntports, bports, nbports, dports, ndports);
+    if (conf[TRACE_FILE].set) {
+	Metrics::trace(conf[TRACE_FILE].str,
+		       (conf[TRACE_THRESHOLD].set) ?
+			(Uint) conf[TRACE_THRESHOLD].num : 100);
+    }
+
     /* initialize arrays */
     Array::init((int) conf[ARRAY_SIZE].num);
 
@@ -1553,14 +1582,16 @@ bool Config::init(char *configfile, char *snapshot, char *snapshot2,
     Swap::init(conf[SWAP_FILE].str, (Sector) conf[SWAP_SIZE].num, cache,
 	       (unsigned int) conf[SECTOR_SIZE].num);
 
-    /* initialize swapped data handler */
-    Dataspace::init();
+    /* initialize swapped data handler, memory target given in megabytes */
+    Dataspace::init((conf[SWAP_MEMORY].set) ?
+		     (size_t) conf[SWAP_MEMORY].num << 20 : 0);
     Control::init();
     *fragment = conf[SWAP_FRAGMENT].num;
 
     /* initalize editor */
     Editor::init(conf[ED_TMPFILE].str,
-		 (int) conf[EDITORS].num);
+		 (int) conf[EDITORS].num,
+		 (conf[ED_CACHE].set) ? (int) conf[ED_CACHE].num : NR_EDBUFS);
 
     /* initialize call_outs */
     if (!CallOut::init((uindex) conf[CALL_OUTS].num)) {
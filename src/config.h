@@ -80,6 +80,10 @@ typedef unsigned short kfindex;
 # define OUTBUF_SIZE	8192	/* telnet output buffer size */
 # define BINBUF_SIZE	8192	/* binary/UDP input buffer size */
 # define UDPHASHSZ	10	/* # characters in UDP challenge to hash */
+# define MAXACCEPT	64	/* max # connections accepted per port per turn */
+
+/* metrics */
+# define TRACESZ	1024	/* # records in slow task ring file */
 
 /* swap */
 # define SWAPCHUNK	(128 * 1024 * 1024)
@@ -89,20 +93,25 @@ typedef unsigned short kfindex;
 # define EXTRA_STACK	32	/* extra space in stack frames */
 # define MAX_STRLEN	SSIZET_MAX	/* max string length, >= 65535 */
 # define INHASHSZ	4096	/* instanceof hashtable size */
+# define SCANFTABSZ	256	/* sscanf format cache size */
+# define SCANFMAXLEN	256	/* max. length of cached sscanf format */
 
 /* parser */
 # define MAX_AUTOMSZ	6	/* DFA/PDA storage size, in strings */
 # define PARSERULTABSZ	256	/* size of parse rule hash table */
 # define PARSERULHASHSZ	10	/* # characters in parse rule symbols to hash */
+# define RGXTABSZ	32	/* regular expression cache size */
 
 /* editor */
-# define NR_EDBUFS	3	/* # buffers in editor cache (>= 3) */
+# define NR_EDBUFS	64	/* default # buffers in editor cache (>= 3) */
 /*# define TMPFILE_SIZE	2097152 */ /* max. editor tmpfile size */
 
 /* lexical scanner */
 # define INCLUDEDEPTH	64	/* maximum include depth */
 # define MACTABSZ	16384	/* macro hash table size */
 # define MACHASHSZ	10	/* # characters in macros to hash */
+# define HDRTABSZ	256	/* include file cache table size */
+# define TOUCHTABSZ	256	/* touched macros table size */
 
 /* compiler */
 # define YYMAXDEPTH	500	/* parser stack size */
@@ -283,6 +283,136 @@ private:
     Chunk<COPatch, COPCHUNKSZ> chunk;	/* callout patch chunk */
 };
 
+# define RBCHUNKSZ	32
+
+class RefBak : public ChunkAllocated {
+public:
+    RefBak(ArrRef *a) : aref(a), sref((StrRef *) NULL) {
+	arr = *a;
+	if (arr.arr != (Array *) NULL) {
+	    arr.arr->ref();
+	}
+    }
+
+    RefBak(StrRef *s) : aref((ArrRef *) NULL), sref(s) {
+	str = *s;
+	if (str.str != (String *) NULL) {
+	    str.str->ref();
+	}
+    }
+
+    /*
+     * the level of the plane that backed up the reference before
+     */
+    Int level() {
+	return (aref != (ArrRef *) NULL) ? arr.level : str.level;
+    }
+
+    /*
+     * restore the original reference
+     */
+    void restore() {
+	if (aref != (ArrRef *) NULL) {
+	    if (aref->arr != (Array *) NULL) {
+		aref->arr->del();
+	    }
+	    *aref = arr;
+	    if (arr.arr != (Array *) NULL) {
+		arr.arr->primary = aref;
+	    }
+	} else {
+	    if (sref->str != (String *) NULL) {
+		sref->str->del();
+	    }
+	    *sref = str;
+	    if (str.str != (String *) NULL) {
+		str.str->primary = sref;
+	    }
+	}
+    }
+
+    /*
+     * keep the current reference, and release the original
+     */
+    void commit(Dataplane *old, Dataplane *plane, bool release) {
+	if (aref != (ArrRef *) NULL) {
+	    aref->level = plane->level;
+	    if (arr.arr != (Array *) NULL) {
+		if (arr.arr->primary == &old->alocal) {
+		    arr.arr->primary = &plane->alocal;
+		}
+		if (release) {
+		    arr.arr->del();
+		}
+	    }
+	} else {
+	    sref->level = plane->level;
+	    if (release && str.str != (String *) NULL) {
+		str.str->del();
+	    }
+	}
+    }
+
+    ArrRef *aref;		/* array reference backed up */
+    StrRef *sref;		/* string reference backed up */
+    union {
+	ArrRef arr;		/* original array reference */
+	StrRef str;		/* original string reference */
+    };
+};
+
+class RefBackup : public Chunk<RefBak, RBCHUNKSZ> {
+public:
+    /*
+     * commit or discard when iterating over items
+     */
+    virtual bool item(RefBak *rb) {
+	if (plane != (Dataplane *) NULL) {
+	    if (!merge) {
+		/* the backups move to the new commit plane */
+		rb->commit(old, plane, FALSE);
+	    } else if (plane->level == 0 || rb->level() == plane->level) {
+		/* the previous plane has the original already */
+		rb->commit(old, plane, TRUE);
+	    } else {
+		/* backup on previous plane */
+		rb->commit(old, plane, FALSE);
+		if (plane->rchunk == (RefBackup *) NULL) {
+		    plane->rchunk = new RefBackup;
+		}
+		chunknew (*plane->rchunk) RefBak(*rb);
+	    }
+	} else {
+	    rb->restore();
+	}
+
+	return TRUE;
+    }
+
+    /*
+     * commit reference backups
+     */
+    void commit(Dataplane *old, Dataplane *p, bool flag) {
+	this->old = old;
+	plane = p;
+	merge = flag;
+	items();
+    }
+
+    /*
+     * discard reference backups
+     */
+    void discard() {
+	plane = (Dataplane *) NULL;
+	items();
+    }
+
+private:
+    Dataplane *old;			/* plane to commit from */
+    Dataplane *plane;			/* plane to commit to */
+    bool merge;				/* merging? */
+};
+
 
 static Dataplane *plist;		/* list of dataplanes */
 static uindex ncallout;			/* # callouts added */
@@ -301,8 +431,10 @@ Dataplane::Dataplane(Dataspace *data)
     alocal.plane = this;
     alocal.data = data;
     alocal.state = AR_CHANGED;
+    alocal.level = 0;
     arrays = (ArrRef *) NULL;
     strings = (StrRef *) NULL;
+    rchunk = (RefBackup *) NULL;
     coptab = (COPTable *) NULL;
     prev = (Dataplane *) NULL;
     plist = (Dataplane *) NULL;
@@ -313,55 +445,27 @@ Dataplane::Dataplane(Dataspace *data)
  */
 Dataplane::Dataplane(Dataspace *data, Int level) : level(level)
 {
-    Uint i;
-
     flags = data->plane->flags;
     schange = data->plane->schange;
     achange = data->plane->achange;
     imports = data->plane->imports;
 
-    /* copy value information from previous plane */
     original = (Value *) NULL;
     alocal.arr = (Array *) NULL;
     alocal.plane = this;
     alocal.data = data;
     alocal.state = AR_CHANGED;
+    alocal.level = level;
     coptab = data->plane->coptab;
 
-    if (data->plane->arrays != (ArrRef *) NULL) {
-	ArrRef *a, *b;
-
-	arrays = ALLOC(ArrRef, i = data->narrays);
-	for (a = arrays, b = data->plane->arrays; i != 0; a++, b++, --i) {
-	    if (b->arr != (Array *) NULL) {
-		*a = *b;
-		a->arr->primary = a;
-		a->arr->ref();
-	    } else {
-		a->arr = (Array *) NULL;
-	    }
-	}
-    } else {
-	arrays = (ArrRef *) NULL;
-    }
+    /*
+     * The array and string tables are shared by all planes.  References
+     * are backed up when they are first changed on this plane.
+     */
+    arrays = data->plane->arrays;
     achunk = (Array::Backup *) NULL;
-
-    if (data->plane->strings != (StrRef *) NULL) {
-	StrRef *s, *t;
-
-	strings = ALLOC(StrRef, i = data->nstrings);
-	for (s = strings, t = data->plane->strings; i != 0; s++, t++, --i) {
-	    if (t->str != (String *) NULL) {
-		*s = *t;
-		s->str->primary = s;
-		s->str->ref();
-	    } else {
-		s->str = (String *) NULL;
-	    }
-	}
-    } else {
-	strings = (StrRef *) NULL;
-    }
+    strings = data->plane->strings;
+    rchunk = (RefBackup *) NULL;
 
     prev = data->plane;
     data->plane = this;
@@ -369,6 +473,34 @@ Dataplane::Dataplane(Dataspace *data, Int level) : level(level)
     ::plist = this;
 }
 
+/*
+ * back up an array reference before it is changed on this plane
+ */
+void Dataplane::backupRef(ArrRef *a)
+{
+    if (a->level != level) {
+	if (rchunk == (RefBackup *) NULL) {
+	    rchunk = new RefBackup;
+	}
+	chunknew (*rchunk) RefBak(a);
+	a->level = level;
+    }
+}
+
+/*
+ * back up a string reference before it is changed on this plane
+ */
+void Dataplane::backupRef(StrRef *s)
+{
+    if (s->level != level) {
+	if (rchunk == (RefBackup *) NULL) {
+	    rchunk = new RefBackup;
+	}
+	chunknew (*rchunk) RefBak(s);
+	s->level = level;
+    }
+}
+
 /*
  * commit non-swapped arrays among the values
  */
@@ -567,9 +699,11 @@ void Dataplane::commit(Int level, Value *retval)
 	    commit->alocal.plane = commit;
 	    commit->alocal.data = p->alocal.data;
 	    commit->alocal.state = AR_CHANGED;
+	    commit->alocal.level = level - 1;
 	    commit->arrays = p->arrays;
 	    commit->achunk = p->achunk;
 	    commit->strings = p->strings;
+	    commit->rchunk = p->rchunk;
 	    commit->coptab = p->coptab;
 	    commit->prev = p->prev;
 	    *cr = commit;
@@ -621,35 +755,11 @@ void Dataplane::commit(Int level, Value *retval)
 	}
 
 	Array::commit(&p->achunk, p->prev, (p->flags & PLANE_MERGE) != 0);
-	if (p->flags & PLANE_MERGE) {
-	    if (p->arrays != (ArrRef *) NULL) {
-		ArrRef *a;
-
-		/* remove old array refs */
-		for (a = p->prev->arrays, i = data->narrays; i != 0; a++, --i) {
-		    if (a->arr != (Array *) NULL) {
-			if (a->arr->primary == &p->alocal) {
-			    a->arr->primary = &p->prev->alocal;
-			}
-			a->arr->del();
-		    }
-		}
-		FREE(p->prev->arrays);
-		p->prev->arrays = p->arrays;
-	    }
-
-	    if (p->strings != (StrRef *) NULL) {
-		StrRef *s;
-
-		/* remove old string refs */
-		for (s = p->prev->strings, i = data->nstrings; i != 0; s++, --i)
-		{
-		    if (s->str != (String *) NULL) {
-			s->str->del();
-		    }
-		}
-		FREE(p->prev->strings);
-		p->prev->strings = p->strings;
+	if (p->rchunk != (RefBackup *) NULL) {
+	    /* commit array and string reference changes */
+	    p->rchunk->commit(p, p->prev, (p->flags & PLANE_MERGE) != 0);
+	    if (p->flags & PLANE_MERGE) {
+		delete p->rchunk;
 	    }
 	}
     }
@@ -749,40 +859,10 @@ void Dataplane::discard(Int level)
 	}
 
 	Array::discard(&p->achunk);
-	if (p->arrays != (ArrRef *) NULL) {
-	    ArrRef *a;
-
-	    /* delete new array refs */
-	    for (a = p->arrays, i = data->narrays; i != 0; a++, --i) {
-		if (a->arr != (Array *) NULL) {
-		    a->arr->del();
-		}
-	    }
-	    FREE(p->arrays);
-	    /* fix old ones */
-	    for (a = p->prev->arrays, i = data->narrays; i != 0; a++, --i) {
-		if (a->arr != (Array *) NULL) {
-		    a->arr->primary = a;
-		}
-	    }
-	}
-
-	if (p->strings != (StrRef *) NULL) {
-	    StrRef *s;
-
-	    /* delete new string refs */
-	    for (s = p->strings, i = data->nstrings; i != 0; s++, --i) {
-		if (s->str != (String *) NULL) {
-		    s->str->del();
-		}
-	    }
-	    FREE(p->strings);
-	    /* fix old ones */
-	    for (s = p->prev->strings, i = data->nstrings; i != 0; s++, --i) {
-		if (s->str != (String *) NULL) {
-		    s->str->primary = s;
-		}
-	    }
+	if (p->rchunk != (RefBackup *) NULL) {
+	    /* restore array and string references */
+	    p->rchunk->discard();
+	    delete p->rchunk;
 	}
 
 	data->plane = p->prev;
@@ -826,6 +906,7 @@ static Dataspace *dhead, *dtail;	/* list of dataspace blocks */
 static Dataspace *gcdata;		/* next dataspace to garbage collect */
 static Dataspace *ifirst;		/* list of dataspaces with imports */
 static Sector ndata;			/* # dataspace blocks */
+static size_t swapmem;			/* memory target, or 0 */
 
 /*
  * allocate a new dataspace block
@@ -850,6 +931,7 @@ Dataspace::Dataspace(Object *obj) : base(this)
 	gcprev = gcnext = this;
     }
     ndata++;
+    refs = 1;
 
     iprev = (Dataspace *) NULL;
     inext = (Dataspace *) NULL;
@@ -914,6 +996,17 @@ Dataspace *Dataspace::create(Object *obj)
  * reference data block
  */
 void Dataspace::ref()
+{
+    if (refs != USHRT_MAX) {
+	refs++;
+    }
+    head();
+}
+
+/*
+ * move data block to the head of the swap list
+ */
+void Dataspace::head()
 {
     if (this != dhead) {
 	/* move to head of list */
@@ -936,6 +1029,7 @@ void Dataspace::ref()
 void Dataspace::deref()
 {
     /* swap this out first */
+    refs = 0;
     if (this != dtail) {
 	if (dhead == this) {
 	    dhead = next;
@@ -1531,25 +1625,26 @@ String *Dataspace::string(Uint idx)
 	}
 
 	str = String::alloc(stext + ssindex[idx], sstrings[idx].len);
-	p = plane;
 
-	do {
-	    if (p->strings == (StrRef *) NULL) {
-		/* initialize string pointers */
-		s = p->strings = ALLOC(StrRef, nstrings);
-		for (i = nstrings; i > 0; --i) {
-		    (s++)->str = (String *) NULL;
-		}
+	if (plane->strings == (StrRef *) NULL) {
+	    /* initialize string pointers */
+	    s = ALLOC(StrRef, nstrings);
+	    for (i = nstrings; i > 0; --i) {
+		(s++)->str = (String *) NULL;
 	    }
-	    s = &p->strings[idx];
-	    s->str = str;
-	    s->str->ref();
-	    s->data = this;
-	    s->ref = sstrings[idx].ref;
-	    p = p->prev;
-	} while (p != (Dataplane *) NULL);
+	    s -= nstrings;
+	    for (p = plane; p != (Dataplane *) NULL; p = p->prev) {
+		p->strings = s;
+	    }
+	}
+	s = &plane->strings[idx];
+	s->str = str;
+	s->str->ref();
+	s->data = this;
+	s->ref = sstrings[idx].ref;
+	s->level = 0;
 
-	str->primary = &plane->strings[idx];
+	str->primary = s;
 	return str;
     }
     return plane->strings[idx].str;
@@ -1587,27 +1682,28 @@ Array *Dataspace::array(Uint idx)
 
 	arr = Array::alloc(sarrays[idx].size);
 	arr->tag = sarrays[idx].tag;
-	p = plane;
 
-	do {
-	    if (p->arrays == (ArrRef *) NULL) {
-		/* create array pointers */
-		a = p->arrays = ALLOC(ArrRef, narrays);
-		for (i = narrays; i > 0; --i) {
-		    (a++)->arr = (Array *) NULL;
-		}
+	if (plane->arrays == (ArrRef *) NULL) {
+	    /* create array pointers */
+	    a = ALLOC(ArrRef, narrays);
+	    for (i = narrays; i > 0; --i) {
+		(a++)->arr = (Array *) NULL;
+	    }
+	    a -= narrays;
+	    for (p = plane; p != (Dataplane *) NULL; p = p->prev) {
+		p->arrays = a;
 	    }
-	    a = &p->arrays[idx];
-	    a->arr = arr;
-	    a->arr->ref();
-	    a->plane = &base;
-	    a->data = this;
-	    a->state = AR_UNCHANGED;
-	    a->ref = sarrays[idx].ref;
-	    p = p->prev;
-	} while (p != (Dataplane *) NULL);
-
-	arr->primary = &plane->arrays[idx];
+	}
+	a = &plane->arrays[idx];
+	a->arr = arr;
+	a->arr->ref();
+	a->plane = &base;
+	a->data = this;
+	a->state = AR_UNCHANGED;
+	a->ref = sarrays[idx].ref;
+	a->level = 0;
+
+	arr->primary = a;
 	arr->prev = &alist;
 	arr->next = alist.next;
 	arr->next->prev = arr;
@@ -2463,6 +2559,7 @@ void Dataspace::refRhs(Value *rhs)
 	str = rhs->string;
 	if (str->primary != (StrRef *) NULL && str->primary->data == this) {
 	    /* in this object */
+	    plane->backupRef(str->primary);
 	    str->primary->ref++;
 	    plane->flags |= MOD_STRINGREF;
 	} else {
@@ -2479,6 +2576,7 @@ void Dataspace::refRhs(Value *rhs)
 	    /* in this object */
 	    if (arr->primary->arr != (Array *) NULL) {
 		/* swapped in */
+		plane->backupRef(arr->primary);
 		arr->primary->ref++;
 		plane->flags |= MOD_ARRAYREF;
 	    } else {
@@ -2516,6 +2614,7 @@ void Dataspace::delLhs(Value *lhs)
 	str = lhs->string;
 	if (str->primary != (StrRef *) NULL && str->primary->data == this) {
 	    /* in this object */
+	    plane->backupRef(str->primary);
 	    if (--(str->primary->ref) == 0) {
 		str->primary->str = (String *) NULL;
 		str->primary = (StrRef *) NULL;
@@ -2538,6 +2637,7 @@ void Dataspace::delLhs(Value *lhs)
 	    if (arr->primary->arr != (Array *) NULL) {
 		/* swapped in */
 		plane->flags |= MOD_ARRAYREF;
+		plane->backupRef(arr->primary);
 		if ((--(arr->primary->ref) & ~ARR_MOD) == 0) {
 		    elts(arr);
 		    arr->primary->arr = (Array *) NULL;
@@ -2663,6 +2763,7 @@ void Dataspace::assignElt(Array *arr, Value *elt, Value *val)
 	 */
 	arr->backup(&data->plane->achunk);
 	if (arr->primary->arr != (Array *) NULL) {
+	    data->plane->backupRef(arr->primary);
 	    arr->primary->plane = data->plane;
 	} else {
 	    arr->primary = &data->plane->alocal;
@@ -2674,6 +2775,7 @@ void Dataspace::assignElt(Array *arr, Value *elt, Value *val)
 	 * the array is in the loaded dataspace of some object
 	 */
 	if ((arr->primary->ref & ARR_MOD) == 0) {
+	    data->plane->backupRef(arr->primary);
 	    arr->primary->ref |= ARR_MOD;
 	    data->plane->flags |= MOD_ARRAY;
 	}
@@ -2715,6 +2817,7 @@ void Dataspace::changeMap(Array *map)
 
     a = map->primary;
     if (a->state == AR_UNCHANGED) {
+	a->data->plane->backupRef(a);
 	a->plane->achange++;
 	a->state = AR_CHANGED;
     }
@@ -3361,6 +3464,7 @@ Object *Dataspace::upgradeLWO(Array *lwobj, Object *obj)
 	if (a->state == AR_UNCHANGED) {
 	    Dataplane *p;
 
+	    a->data->plane->backupRef(a);
 	    a->state = AR_CHANGED;
 	    for (p = a->data->plane; p != (Dataplane *) NULL; p = p->prev) {
 		p->achange++;
@@ -3597,8 +3701,9 @@ void Dataspace::xport()
 /*
  * initialize swapped data handling
  */
-void Dataspace::init()
+void Dataspace::init(size_t target)
 {
+    swapmem = target;
     dhead = dtail = (Dataspace *) NULL;
     gcdata = (Dataspace *) NULL;
     ndata = 0;
@@ -3623,6 +3728,36 @@ void Dataspace::converted()
     convDone = TRUE;
 }
 
+/*
+ * is memory use above the swap target?
+ */
+bool Dataspace::pressure()
+{
+    Alloc::Info *info;
+
+    if (swapmem == 0) {
+	return FALSE;
+    }
+    info = MM->info();
+    return (info->smemused + info->dmemused > swapmem);
+}
+
+/*
+ * should this dataspace block stay in memory for another swap pass?
+ * Each recent reference pays for SWAP_SECTORS sectors, twice that if
+ * the strings are compressed and costlier to reload.
+ */
+bool Dataspace::keep()
+{
+    Uint weight;
+
+    weight = (Uint) refs * SWAP_SECTORS;
+    if (flags & DATA_STRCMP) {
+	weight <<= 1;
+    }
+    return (weight > nsectors);
+}
+
 /*
  * Swap out a portion of the control and dataspace blocks in
  * memory.  Return the number of dataspace blocks swapped out.
@@ -3634,7 +3769,27 @@ Sector Dataspace::swapout(unsigned int frag)
 
     count = 0;
 
-    if (frag != 0) {
+    if (frag != 1 && swapmem != 0) {
+	/*
+	 * swap out dataspace blocks until memory use is below the target,
+	 * giving blocks that earn their keep another pass
+	 */
+	for (n = ndata; n > 1 && pressure(); --n) {
+	    data = dtail;
+	    if (data->keep()) {
+		data->refs >>= 1;
+		data->head();
+	    } else {
+		if (data->save(TRUE)) {
+		    count++;
+		}
+		OBJ(data->oindex)->data = (Dataspace *) NULL;
+		delete data;
+	    }
+	}
+
+	Control::swapout();
+    } else if (frag != 0) {
 	/* swap out dataspace blocks */
 	data = dtail;
 	for (n = ndata / frag, n -= (n > 0 && frag != 1); n > 0; --n) {
@@ -21,6 +21,7 @@ struct StrRef {
     String *str;		/* string value */
     Dataspace *data;		/* dataspace this string is in */
     Uint ref;			/* # of refs */
+    Int level;			/* level of last plane with a backup */
 };
 
 struct ArrRef {
@@ -29,6 +30,7 @@ struct ArrRef {
     Dataspace *data;		/* dataspace this array is in */
     short state;		/* state of mapping */
     Uint ref;			/* # of refs */
+    Int level;			/* level of last plane with a backup */
 };
 
 class Value {
@@ -100,6 +102,8 @@ public:
 
     Array::Backup **commitArray(Array *arr, Dataplane *old);
     void discardArray(Array *arr);
+    void backupRef(ArrRef *a);
+    void backupRef(StrRef *s);
 
     static void commit(Int level, Value *retval);
     static void discard(Int level);
@@ -116,6 +120,7 @@ public:
     ArrRef *arrays;		/* i/o? arrays */
     Array::Backup *achunk;	/* chunk of array backup info */
     StrRef *strings;		/* i/o? string constant table */
+    class RefBackup *rchunk;	/* chunk of array and string ref backups */
     class COPTable *coptab;	/* callout patch table */
 
     Dataplane *prev;		/* previous in per-dataspace linked list */
@@ -161,9 +166,10 @@ public:
     static void wipeExtra(Dataspace *data);
     static Object *upgradeLWO(Array *lwobj, Object *obj);
     static void xport();
-    static void init();
+    static void init(size_t target);
     static void initConv(bool c14, bool c16);
     static void converted();
+    static bool pressure();
     static Sector swapout(unsigned int frag);
     static void upgradeMemory(Object *tmpl, Object *newob);
     static void restoreObject(Object *obj, Uint instance, Uint *counttab,
@@ -195,6 +201,8 @@ private:
     Dataspace(Object *obj);
     virtual ~Dataspace();
 
+    void head();
+    bool keep();
     void freeValues();
     void loadStrings(void (*readv) (char*, Sector*, Uint, Uint));
     String *string(Uint idx);
@@ -229,6 +237,7 @@ private:
 				  unsigned short *nvariables);
 
     Dataspace *prev, *next;	/* swap list */
+    unsigned short refs;	/* references since last swap pass */
     Dataspace *gcprev, *gcnext;	/* garbage collection list */
 
     Dataspace *iprev;		/* previous in import list */
@@ -259,6 +268,8 @@ private:
 # define THISPLANE(a)		((a)->plane == (a)->data->plane)
 # define SAMEPLANE(d1, d2)	((d1)->plane->level == (d2)->plane->level)
 
+# define SWAP_SECTORS		8	/* sectors kept in memory per reference */
+
 /* bit values for dataspace->flags */
 # define DATA_STRCMP		0x03	/* strings compressed */
 
@@ -28,9 +28,11 @@
 # include "editor.h"
 # include "call_out.h"
 # include "comm.h"
+# include "metrics.h"
 # include "ext.h"
 # include "node.h"
 # include "compile.h"
+# include "parse.h"
 # include <stdarg.h>
 
 static uindex dindex;		/* driver object index */
@@ -77,13 +79,17 @@ void DGD::interrupt()
  */
 void DGD::endTask()
 {
+    Metrics::phase(MT_FLUSH);
     Comm::flush();
+    Metrics::phase(MT_XPORT);
     Dataspace::xport();
+    Metrics::phase(MT_INTERPRET);
     Object::clean();
     Frame::clear();
     Editor::clear();
     EC->clearException();
 
+    Metrics::phase(MT_SWAPOUT);
     CallOut::swapcount(Dataspace::swapout(fragment));
 
     if (Object::stop) {
@@ -99,11 +105,13 @@ void DGD::endTask()
 	 * swap out everything and possibly extend the static memory area
 	 */
 	Dataspace::swapout(1);
+	Regexp::clear();
 	Array::freeall();
 	String::clean();
 	MM->purge();
 	Object::swap = FALSE;
     }
+    Metrics::phase(MT_INTERPRET);
 
     if (Object::dump) {
 	/*
@@ -117,7 +125,12 @@ void DGD::endTask()
 	}
     }
 
+    Metrics::endTask();
+
     if (Object::stop) {
+# ifdef IPAIRS
+	Frame::pairs();
+# endif
 	Swap::finish();
 	Config::modFinish();
 	Ext::finish();
@@ -133,6 +146,7 @@ void DGD::endTask()
 	    EC->message("Hotboot failed\012");	/* LF */
 	}
 
+	Metrics::finish();
 	Comm::finish();
 	Array::freeall();
 	String::clean();
@@ -226,5 +240,8 @@ int DGD::main(int argc, char **argv)
 
 	/* callouts */
 	CallOut::call(cframe);
+
+	/* export metrics */
+	Metrics::report();
     }
 }
@@ -0,0 +1,113 @@
+/*
+ * This file is part of DGD, https://github.com/dworkin/dgd
+ * Copyright (C) 1993-2010 Dworkin B.V.
+ * Copyright (C) 2010-2021 DGD Authors (see the commit log for details)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+# include "dgd.h"
+# include "metrics.h"
+# include <time.h>
+
+/*
+ * print the slow task ring file written by the driver
+ */
+
+static const char *phases[MT_NPHASES] = {
+    "interpret", "swap-in", "swap-out", "compile", "export", "flush"
+};
+
+/*
+ * print milliseconds, given microseconds
+ */
+static void msec(const char *name, Uuint usec)
+{
+    printf("%s %lu.%03lu ms", name, (unsigned long) (usec / 1000),
+	   (unsigned long) (usec % 1000));
+}
+
+/*
+ * print one record
+ */
+static void print(TraceRecord *rec)
+{
+    time_t t;
+    char buf[26];
+    int i;
+
+    t = rec->time;
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+    printf("%s  ", buf);
+    if (rec->function[0] != '\0') {
+	printf("/%s->%s()\n", rec->object, rec->function);
+    } else {
+	printf("(no function called)\n");
+    }
+    msec("   ", rec->duration);
+    printf(", %lu ticks, memory %+ld\n", (unsigned long) rec->ticks,
+	   (long) (rec->mend - rec->mstart));
+    printf("   ");
+    for (i = 0; i < MT_NPHASES; i++) {
+	if (rec->phase[i] != 0) {
+	    msec(phases[i], rec->phase[i]);
+	    printf("  ");
+	}
+    }
+    putchar('\n');
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    TraceHeader header;
+    TraceRecord rec;
+    Uint i, n, first;
+
+    if (argc < 2 || argc > 3) {
+	fprintf(stderr, "Usage: %s trace_file [count]\n", argv[0]);
+	return 2;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+	perror(argv[1]);
+	return 1;
+    }
+    if (fread(&header, sizeof(TraceHeader), 1, fp) != 1 ||
+	header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+	header.size != sizeof(TraceRecord) || header.nrecords == 0) {
+	fprintf(stderr, "%s: not a trace file\n", argv[1]);
+	return 1;
+    }
+
+    /* oldest record first */
+    n = (header.count < header.nrecords) ? header.count : header.nrecords;
+    if (argc > 2 && (Uint) atoi(argv[2]) < n) {
+	n = atoi(argv[2]);
+    }
+    first = (header.next + header.nrecords - n) % header.nrecords;
+    for (i = 0; i < n; i++) {
+	fseek(fp, sizeof(TraceHeader) +
+		  (long) ((first + i) % header.nrecords) * sizeof(TraceRecord),
+	      SEEK_SET);
+	if (fread(&rec, sizeof(TraceRecord), 1, fp) != 1) {
+	    break;
+	}
+	print(&rec);
+    }
+    printf("%lu slow tasks logged\n", (unsigned long) header.count);
+
+    fclose(fp);
+    return 0;
+}
@@ -27,8 +27,8 @@
 /*
  * create a new edit buffer
  */
-EditBuf::EditBuf(char *tmpfile) :
-    lb(tmpfile)
+EditBuf::EditBuf(char *tmpfile, int cache) :
+    lb(tmpfile, cache)
 {
     buffer = (Block) 0;
     lines = 0;
@@ -289,7 +289,7 @@ void EditBuf::addblock(const char *text)
 
     len = strlen(text) + 1;
 
-    if (szlines + len >= sizeof(llines)) {
+    if (szlines + len >= sizeof(llbuf)) {
 	flushLine();
     }
     memcpy(llbuf + szlines, text, len);
@@ -21,7 +21,7 @@
 
 class EditBuf {
 public:
-    EditBuf(char *tmpfile);
+    EditBuf(char *tmpfile, int cache);
     virtual ~EditBuf();
 
     void clear();
@@ -949,7 +949,7 @@ void CmdBuf::subst(const char *text)
     char *p;
     Int *k, *l;
     Int newlines;
-    bool found;
+    bool found, skip;
 
     cb = ccb;
 
@@ -962,7 +962,10 @@ void CmdBuf::subst(const char *text)
      * not remain in memory, use a local copy.
      */
     text = strcpy(line, text);
-    while (cb->regexp.exec(text, idx, IGNORECASE(cb->vars)) > 0) {
+    /* in a global substitute, skip lines not selected by the global */
+    skip = ((cb->flags & CB_GLOBFIND) &&
+	    cb->glob_rx->exec(text, 0, cb->ignorecase) == (int) cb->reverse);
+    while (!skip && cb->regexp.exec(text, idx, IGNORECASE(cb->vars)) > 0) {
 	if (cb->flags & CB_SKIPPED) {
 	    /*
 	     * add the previous line, in which nothing was substituted, to
@@ -1130,19 +1133,20 @@ void CmdBuf::subst(const char *text)
 	    cb->flags |= CB_SKIPPED;
 	}
     }
+    if ((cb->flags & CB_GLOBFIND) && !skip) {
+	cb->sthis = cb->lineno + cb->offset;
+    }
     cb->lineno++;
 }
 
 /*
- * do substitutions on a range of lines
+ * get the search pattern and replace string of a substitute command, and
+ * compile the pattern
  */
-int CmdBuf::subst()
+void CmdBuf::substpat()
 {
-    char buf[MAX_LINE_SIZE], delim;
-    Int m[26];
-    Int edit;
+    char delim;
     const char *p;
-    Int *k, *l;
 
     delim = cmd[0];
     if (delim == '\0' || strchr("0123456789gpl#-+", delim) != (char*) NULL) {
@@ -1186,8 +1190,18 @@ int CmdBuf::subst()
     if (p != (char *) NULL) {
 	EDC->error(p);
     }
+}
+
+/*
+ * do substitutions on the lines in the current range
+ */
+void CmdBuf::dosubst()
+{
+    char buf[MAX_LINE_SIZE];
+    Int m[26];
+    Int edit;
+    Int *k, *l;
 
-    count();	/* get count */
     /* handle global flag */
     if (cmd[0] == 'g') {
 	flags |= CB_GLOBSUBST;
@@ -1227,10 +1241,82 @@ int CmdBuf::subst()
     } else if (!(flags & CB_GLOBAL)) {
 	EDC->error("Substitute pattern match failed");
     }
+}
+
+/*
+ * do substitutions on a range of lines
+ */
+int CmdBuf::subst()
+{
+    substpat();
+    count();	/* get count */
+    dosubst();
 
     return RET_FLAGS;
 }
 
+/*
+ * Do the substitute command of a global command on all lines in a single
+ * pass, rather than line by line. Only done if nothing follows the
+ * substitute command. Return TRUE if successful.
+ */
+bool CmdBuf::globsubst(const char *command)
+{
+    const char *p;
+    Int cthis, othis;
+    bool found;
+
+    /*
+     * Find the first line selected by the global.  The substitute command
+     * is not parsed until then, so a global that selects no lines does
+     * nothing, as it would otherwise.
+     */
+    found = FALSE;
+    try {
+	edbuf.range(glob_next, glob_next + glob_size - 1, globfind, FALSE);
+    } catch (...) {
+	found = TRUE;
+    }
+    if (!found) {
+	return TRUE;
+    }
+    cthis = this->cthis;
+    othis = this->othis;
+    this->cthis = glob_next - 1;
+
+    cmd = skipst(command);
+    substpat();
+    p = cmd;
+    if (*p == 'g') {
+	p++;
+    }
+    p = skipst(p);
+    if (*p != '\0') {
+	/* the global will find this line again */
+	glob_next--;
+	glob_size++;
+	cmd = p + strlen(p);
+	return FALSE;
+    }
+
+    glob_next = last + 1;
+    glob_size = 0;
+    sthis = 0;
+    flags |= CB_GLOBFIND;
+    dosubst();
+    flags &= ~CB_GLOBFIND;
+    cmd = p;
+
+    if (sthis != 0) {
+	/* the last line matched becomes the current line */
+	this->cthis = this->othis = sthis;
+    } else {
+	this->cthis = cthis;
+	this->othis = othis;
+    }
+    return TRUE;
+}
+
 
 /*
  * copy a string to another buffer, unless it has length 0 or
@@ -175,7 +175,7 @@ int main(int argc, char *argv[])
     CmdBuf *ed;
 
     sprintf(tmp, "/tmp/ed%05d", (int) getpid());
-    ed = new CmdBuf(tmp);
+    ed = new CmdBuf(tmp, NR_EDBUFS);
     if (argc > 1) {
 	sprintf(line, "e %s", argv[1]);
 	try {
@@ -30,8 +30,8 @@ CmdBuf *ccb;		/* editor command buffer */
 /*
  * create and initialize a command edit buffer
  */
-CmdBuf::CmdBuf(char *tmpfile) :
-    edbuf(tmpfile)
+CmdBuf::CmdBuf(char *tmpfile, int cache) :
+    edbuf(tmpfile, cache)
 {
     vars = Vars::create();
 
@@ -59,6 +59,7 @@ CmdBuf::CmdBuf(char *tmpfile) :
     shift = 0;
     offset = 0;
     moffset = (Int *) NULL;
+    sthis = 0;
     memset(mark, '\0', sizeof(mark));
     Block buf = 0;
     memset(zbuf, '\0', sizeof(zbuf));
@@ -659,22 +660,25 @@ int CmdBuf::global()
 	glob_next = first;
 	glob_size = last - first + 1;
 
-	do {
-	    try {
-		/* search */
-		edbuf.range(glob_next, glob_next + glob_size - 1, globfind,
-			    FALSE);
-	    } catch (...) {
-		/* found: do the commands */
-		cthis = glob_next - 1;
-		command(p);
-	    }
-	} while (glob_size > 0);
+	if (p[0] != 's' || isalpha(p[1]) || !globsubst(p + 1)) {
+	    do {
+		try {
+		    /* search */
+		    edbuf.range(glob_next, glob_next + glob_size - 1, globfind,
+				FALSE);
+		} catch (...) {
+		    /* found: do the commands */
+		    cthis = glob_next - 1;
+		    command(p);
+		}
+	    } while (glob_size > 0);
+	}
 
 	/* pop error context */
 	aborted = FALSE;
 	EDC->pop();
     } catch (...) {
+	EDC->pop();
 	aborted = TRUE;
     }
     /* come here if global is finished or in case of an error */
@@ -688,7 +692,7 @@ int CmdBuf::global()
     memcpy(this->umark, umark, sizeof(umark));
 
     /* no longer in global */
-    flags &= ~CB_GLOBAL;
+    flags &= ~(CB_GLOBAL | CB_GLOBFIND);
 
     if (aborted) {
 	EDC->error((char *) NULL);
@@ -43,10 +43,11 @@
 # define CB_LOWER	0x0800
 # define CB_TUPPER	0x1000
 # define CB_TLOWER	0x2000
+# define CB_GLOBFIND	0x4000
 
 class CmdBuf : public Allocated {
 public:
-    CmdBuf(char *tmpfile);
+    CmdBuf(char *tmpfile, int cache);
     virtual ~CmdBuf();
 
     bool command(const char *command);
@@ -103,6 +104,9 @@ private:
     void noshift(const char *text);
     void sub(const char *text, unsigned int size);
     bool getfname(char *buffer);
+    void substpat();
+    void dosubst();
+    bool globsubst(const char *command);
 
     static const char *skipst(const char *p);
     static const char *pattern(const char *pat, int delim, char *buffer);
@@ -149,6 +153,7 @@ private:
     /* substituting */
     Int offset;			/* offset in lines */
     Int *moffset;		/* mark offsets */
+    Int sthis;			/* last line matched in global substitute */
 
     Int mark[26];		/* line numbers of marks */
     Block buf;			/* default yank buffer */
@@ -133,6 +133,7 @@ bool IO::load(EditBuf *eb, char *fname, Int l)
 	eb->add(l, get_line);
 	EDC->pop();
     } catch (...) {
+	EDC->pop();
 	P_close(ffd);
 	EDC->error((char *) NULL);	/* pass on error */
     }
@@ -215,6 +216,7 @@ bool IO::save(EditBuf *eb, char *fname, Int first, Int last, int append)
 	}
 	EDC->pop();
     } catch (...) {
+	EDC->pop();
 	P_close(ffd);
 	EDC->error((char *) NULL);	/* pass on error */
     }
@@ -24,8 +24,9 @@
 /*
  *   The blocks in a line buffer are written in a temporary file, and read back
  * if needed. There are at least 3 temporary file buffers: a write buffer and
- * two read buffers. If a block is not in one of those buffers, it is loaded
- * in the read buffer that wasn't used in the last read buffer access.
+ * two or more read buffers, hashed by their offset in the tmpfile. If a block
+ * is not in one of those buffers, it is loaded in the read buffer that was
+ * least recently used.
  *   The write buffer is filled with blocks on one side and text on the other.
  * If there is no more room for another block or more text, the buffer is
  * written to the tmpfile, the "most recently used" read buffer becomes the
@@ -75,26 +76,35 @@
 # define EDMAXDEPTH	10000
 
 /*
- * Create a new line buffer.  Arg 2 is the tmp file name.
+ * Create a new line buffer.  Arg 1 is the tmp file name, arg 2 the number
+ * of buffers to cache the tmpfile with.
  */
-LineBuf::LineBuf(char *filename)
+LineBuf::LineBuf(char *filename, int nbufs)
 {
     int i;
     BTBuf *bt;
 
     file = strcpy(ALLOC(char, strlen(filename) + 1), filename);
 
-    bt = this->bt;
-    for (i = NR_EDBUFS; i > 0; --i) {
+    this->nbufs = nbufs;
+    bt = this->bt = ALLOC(BTBuf, nbufs);
+    for (i = 0; i < nbufs; i++) {
 	bt->prev = bt - 1;
 	bt->next = bt + 1;
-	bt->buf = ALLOC(char, BLOCK_SIZE);
+	/* buffers beyond the minimum are allocated when needed */
+	bt->buf = (i < 3) ? ALLOC(char, BLOCK_SIZE) : (char *) NULL;
 	bt++;
     }
     --bt;
     this->bt[0].prev = bt;
     bt->next = this->bt;
 
+    grown = FALSE;
+
+    for (hmask = 1; hmask < nbufs; hmask <<= 1) ;
+    htab = ALLOC(BTBuf*, hmask);
+    --hmask;
+
     init();
 }
 
@@ -116,10 +126,14 @@ LineBuf::~LineBuf()
 
     /* release memory */
     bt = this->bt;
-    for (i = NR_EDBUFS; i > 0; --i) {
-	FREE(bt->buf);
+    for (i = nbufs; i > 0; --i) {
+	if (bt->buf != (char *) NULL) {
+	    FREE(bt->buf);
+	}
 	bt++;
     }
+    FREE(this->bt);
+    FREE(htab);
 }
 
 /*
@@ -132,11 +146,13 @@ void LineBuf::init()
     BTBuf *bt;
 
     /* initialize */
-    wb = bt = this->bt;
-    (bt++)->offset = 0;		/* in use, but empty */
-    for (i = NR_EDBUFS - 1; i > 0; --i) {
+    memset(htab, '\0', (hmask + 1) * sizeof(BTBuf*));
+    bt = this->bt;
+    for (i = nbufs; i > 0; --i) {
 	(bt++)->offset = -BLOCK_SIZE;	/* not in use */
     }
+    wb = this->bt;
+    hash(wb, 0);		/* in use, but empty */
     blksz = 0;
     txtsz = 0;
 
@@ -164,11 +180,63 @@ void LineBuf::reset()
  */
 void LineBuf::inact()
 {
+    BTBuf *keep[3], *bt;
+    long offset;
+    int i;
+
     /* close tmpfile, to save descriptors */
     if (fd >= 0) {
 	P_close(fd);
 	fd = -1;
     }
+
+    if (grown) {
+	/*
+	 * release the buffers beyond the minimum, keeping the write buffer
+	 * and the two most recently used read buffers
+	 */
+	keep[0] = wb;
+	keep[1] = wb->next;
+	keep[2] = wb->next->next;
+	for (i = 0; i < 3; i++) {
+	    if (keep[i] >= this->bt + 3) {
+		for (bt = this->bt;
+		     bt == keep[0] || bt == keep[1] || bt == keep[2]; bt++) ;
+		memcpy(bt->buf, keep[i]->buf, BLOCK_SIZE);
+		bt->offset = keep[i]->offset;
+		keep[i] = bt;
+	    }
+	}
+
+	for (bt = this->bt + 3, i = nbufs - 3; i > 0; bt++, --i) {
+	    bt->prev = bt - 1;
+	    bt->next = bt + 1;
+	    if (bt->buf != (char *) NULL) {
+		FREE(bt->buf);
+		bt->buf = (char *) NULL;
+	    }
+	    bt->offset = -BLOCK_SIZE;
+	}
+	keep[0]->next = keep[1];
+	keep[1]->prev = keep[0];
+	keep[1]->next = keep[2];
+	keep[2]->prev = keep[1];
+	keep[2]->next = this->bt + 3;
+	this->bt[3].prev = keep[2];
+	keep[0]->prev = --bt;
+	bt->next = keep[0];
+	wb = keep[0];
+
+	memset(htab, '\0', (hmask + 1) * sizeof(BTBuf*));
+	for (i = 0; i < 3; i++) {
+	    offset = keep[i]->offset;
+	    keep[i]->offset = -BLOCK_SIZE;
+	    if (offset >= 0) {
+		hash(keep[i], offset);
+	    }
+	}
+	grown = FALSE;
+    }
 }
 
 /*
@@ -187,6 +255,23 @@ void LineBuf::act()
     }
 }
 
+/*
+ * return the least recently used buffer.  Buffers beyond the minimum are
+ * allocated as needed, and released again when the line buffer is made
+ * inactive.
+ */
+LineBuf::BTBuf *LineBuf::lru()
+{
+    BTBuf *bt;
+
+    bt = wb->prev;
+    if (bt->buf == (char *) NULL) {
+	bt->buf = ALLOC(char, BLOCK_SIZE);
+	grown = TRUE;
+    }
+    return bt;
+}
+
 /*
  * Write the output buffer to the tmpfile.
  */
@@ -210,59 +295,73 @@ void LineBuf::write()
 	    EDC->error("Failed to write editor tmpfile");
 	}
 	/* cycle buffers */
-	wb = wb->prev;
-	wb->offset = offset + BLOCK_SIZE;
+	wb = lru();
+	hash(wb, offset + BLOCK_SIZE);
 	blksz = 0;
 	txtsz = 0;
     }
 }
 
+/*
+ * move a buffer to a new offset in the hash table
+ */
+void LineBuf::hash(BTBuf *bt, long offset)
+{
+    BTBuf **h;
+
+    if (bt->offset >= 0) {
+	/* remove from old hash chain */
+	for (h = &htab[(bt->offset / BLOCK_SIZE) & hmask]; *h != bt;
+	     h = &(*h)->hnext) ;
+	*h = bt->hnext;
+    }
+    bt->offset = offset;
+    h = &htab[(offset / BLOCK_SIZE) & hmask];
+    bt->hnext = *h;
+    *h = bt;
+}
+
 /*
  * return a pointer to the blk struct of arg 1. If needed, it is
  * loaded in memory first.
  */
 LineBuf::Blk *LineBuf::load(Block b)
 {
-    BTBuf *bt;
-
-    /* check the write buffer */
-    bt = wb;
-    if (b < bt->offset || b >= bt->offset + blksz) {
-	/*
-	 * walk through the read buffers to see if the block can be found
-	 */
-	for (;;) {
-	    bt = bt->next;
-	    if (bt == wb) {
-		/*
-		 * refill read buffer
-		 */
-		act();
-		bt = bt->prev;
-		P_lseek(fd, bt->offset = b - (b % BLOCK_SIZE), SEEK_SET);
-		if (P_read(fd, bt->buf, BLOCK_SIZE) != BLOCK_SIZE) {
-		    EDC->fatal("cannot read editor tmpfile \"%s\"", file);
-		}
+    BTBuf *bt, *rd;
+    long offset;
+
+    offset = b - (b % BLOCK_SIZE);
+    rd = wb->next;
+    if (rd->offset != offset) {
+	/* look it up */
+	for (bt = htab[(offset / BLOCK_SIZE) & hmask];
+	     bt != (BTBuf *) NULL && bt->offset != offset; bt = bt->hnext) ;
+	if (bt == (BTBuf *) NULL) {
+	    /*
+	     * refill least recently used read buffer
+	     */
+	    act();
+	    bt = lru();
+	    hash(bt, offset);
+	    P_lseek(fd, offset, SEEK_SET);
+	    if (P_read(fd, bt->buf, BLOCK_SIZE) != BLOCK_SIZE) {
+		EDC->fatal("cannot read editor tmpfile \"%s\"", file);
 	    }
+	}
 
-	    if (b >= bt->offset && b < bt->offset + BLOCK_SIZE) {
-		BTBuf *rd;
-
-		rd = wb->next;
-		if (bt != rd) {
-		    /*
-		     * make this buffer the "first" read buffer
-		     */
-		    bt->prev->next = bt->next;
-		    bt->next->prev = bt->prev;
-		    bt->prev = rd->prev;
-		    bt->next = rd;
-		    rd->prev->next = bt;
-		    rd->prev = bt;
-		}
-		break;
-	    }
+	if (bt != wb && bt != rd) {
+	    /*
+	     * make this buffer the "first" read buffer
+	     */
+	    bt->prev->next = bt->next;
+	    bt->next->prev = bt->prev;
+	    bt->prev = wb;
+	    bt->next = rd;
+	    wb->next = bt;
+	    rd->prev = bt;
 	}
+    } else {
+	bt = rd;
     }
 
     return (Blk *) ((buf = bt->buf) + b - bt->offset);
@@ -28,7 +28,7 @@ typedef Int Block;
 
 class LineBuf {
 public:
-    LineBuf(char *filename);
+    LineBuf(char *filename, int nbufs);
     virtual ~LineBuf();
 
     void reset();
@@ -45,6 +45,7 @@ private:
 	long offset;			/* offset in tmpfile */
 	BTBuf *prev;			/* prev in linked list */
 	BTBuf *next;			/* next in linked list */
+	BTBuf *hnext;			/* next in hash chain */
 	char *buf;			/* buffer with blocks and text */
     };
     struct Blk {
@@ -61,7 +62,9 @@ private:
 
     void init();
     void act();
+    BTBuf *lru();
     void write();
+    void hash(BTBuf *bt, long offset);
     Blk *load(Block b);
     Blk *putblk(Blk *bp, char *text);
     Blk *putln(Blk *bp, char *text);
@@ -76,5 +79,9 @@ private:
     void (*putline) (const char*);	/* output line function */
     bool reverse;			/* for bk_put() */
     BTBuf *wb;				/* write buffer */
-    BTBuf bt[NR_EDBUFS];		/* read & write buffers */
+    bool grown;				/* buffers beyond the minimum in use */
+    int nbufs;				/* # read & write buffers */
+    BTBuf *bt;				/* read & write buffers */
+    BTBuf **htab;			/* buffers hashed by offset */
+    long hmask;				/* hash table mask */
 };
@@ -30,6 +30,7 @@ static Editor *editors;		/* editor table */
 static Editor *flist;		/* free list */
 static int neditors;		/* # of editors */
 static char *tmpedfile;		/* proto temporary file */
+static int edcache;		/* # buffers in editor cache */
 static char *outbuf;		/* output buffer */
 static Uint outbufsz;		/* chars in output buffer */
 static eindex newed;		/* new editor in current task */
@@ -66,7 +67,11 @@ public:
 	    va_end(args);
 	    EC->error(ebuf);
 	} else {
-	    EC->error((char *) NULL);
+	    /*
+	     * The error context was already unwound when the error was
+	     * raised; just pass it on to the editor command.
+	     */
+	    throw "editor error";
 	}
     }
 
@@ -96,11 +101,12 @@ ErrorContext *EDC = &EDEC;
 /*
  * initialize editor handling
  */
-void Editor::init(char *tmp, int num)
+void Editor::init(char *tmp, int num, int cache)
 {
     Editor *e, *f;
 
     tmpedfile = tmp;
+    edcache = cache;
     f = (Editor *) NULL;
     neditors = num;
     if (num != 0) {
@@ -169,7 +175,7 @@ void Editor::create(Object *obj)
 
     sprintf(tmp, "%s%05u", tmpedfile, EINDEX(obj->etabi));
     MM->staticMode();
-    e->ed = new CmdBuf(tmp);
+    e->ed = new CmdBuf(tmp, edcache);
     MM->dynamicMode();
 }
 
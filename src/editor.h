@@ -22,7 +22,7 @@ public:
     class CmdBuf *ed;		/* editor instance */
     Editor *next;		/* next in free list */
 
-    static void init(char *tmp, int num);
+    static void init(char *tmp, int num, int cache);
     static void finish();
     static void clear();
     static void create(Object *obj);
@@ -101,6 +101,22 @@ unsigned short Hashtab::hashmem(const char *mem, unsigned int len)
     return (unsigned short) ((h << 8) | l);
 }
 
+/*
+ * 32-bit hash of memory (FNV-1a), for tables that must distinguish
+ * many keys without chaining
+ */
+Uint Hashtab::hashkey(const char *mem, unsigned int len)
+{
+    Uint h;
+
+    h = 0x811c9dc5L;
+    while (len > 0) {
+	h = (h ^ (unsigned char) *mem++) * 0x01000193L;
+	--len;
+    }
+    return h;
+}
+
 
 /*
  * create a new hashtable of size "size", where "maxlen" characters
@@ -31,6 +31,7 @@ public:
     }
     static unsigned short hashstr(const char *str, unsigned int len);
     static unsigned short hashmem(const char *mem, unsigned int len);
+    static Uint hashkey(const char *mem, unsigned int len);
 
     struct Entry {
 	Entry *next;		/* next entry in hash table */
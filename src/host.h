@@ -248,7 +248,7 @@ extern void  P_message	(const char*);
 # ifdef INCLUDE_FILE_IO
 # if defined(GENERIC_BSD) || defined(GENERIC_SYSV)
 	/* no filename translation */
-# define path_native(buf, path)	(path)
+# define path_native(buf, path)	((void) (buf), (path))
 
 # define P_open		::open
 # define P_close	::close
@@ -301,6 +301,7 @@ extern long  P_random	();
 
 extern Uint  P_time	();
 extern Uint  P_mtime	(unsigned short*);
+extern Uuint P_utime	();
 extern char *P_ctime	(char*, Uint);
 
 /* these must be the same on all hosts */
@@ -25,9 +25,34 @@
 # include "interpret.h"
 # include "asn.h"
 
+/*
+ * Numbers are stored in limbs of the widest unsigned type for which the
+ * compiler provides a double-width product.
+ */
+# ifdef __SIZEOF_INT128__
+typedef Uuint Limb;
+typedef unsigned __int128 Dlimb;
+# define LIMB_SHIFT	6
+# else
+typedef Uint Limb;
+typedef Uuint Dlimb;
+# define LIMB_SHIFT	5
+# endif
+# define LIMB_BITS	(1 << LIMB_SHIFT)
+# define LIMB_MASK	(LIMB_BITS - 1)
+# define LIMB_BYTES	(LIMB_BITS >> 3)
+# define LIMB_MSB	((Limb) 1 << LIMB_MASK)
+# define LIMB_MAX	((Limb) -1)
+
+# define LIMBS(len)	((len) >> (LIMB_SHIFT - 3))	/* limbs in len bytes */
+# define WORDS(size)	((size) << (LIMB_SHIFT - 5))	/* for tick costs */
+
+# define KMULTSZ	16	/* smallest size for Karatsuba multiplication */
+# define MONTCACHE	8	/* number of cached Montgomery contexts */
+
 class Asi {
 public:
-    Asi(Uint *num, Uint size) : num(num), size(size) { }
+    Asi(Limb *num, Uint size) : num(num), size(size) { }
     Asi() {
 	num = NULL;
 	size = 0;
@@ -41,35 +66,45 @@ public:
     int cmp(Asi &a);
     void mult(Asi &x, Asi &y, Asi &t);
     void sqr(Asi &x, Asi &t);
-    Uint *div(Asi &x, Asi &y, Asi &t);
+    Limb *div(Asi &x, Asi &y, Asi &t);
     bool modinv(Asi &x, Asi &y);
     void power(Asi &a, Asi &b, Asi &mod, Asi &t);
     bool strtonum(String *str);
     String *numtostr(bool minus);
 
-    Uint *num;
+    Limb *num;
     Uint size;
 
 private:
-    void mult1(Uint a, Uint b);
+    struct Montgomery {
+	Limb *mod;		/* odd modulus */
+	Limb *r2;		/* R ** 2 % mod */
+	Uint size;		/* size of modulus */
+	Limb n0;		/* -(mod ** -1) % 2 ** LIMB_BITS */
+    };
+
     void multInner(Asi &x, Asi &y, Asi &t);
-    bool multRow(Asi &x, Uint y);
-    void sqr1(Uint a);
-    Uint div1(Uint a);
-    void monpro(Asi &x, Asi &y, Asi &n, Asi &t, Uint n0);
+    bool multRow(Asi &x, Limb y);
+    Limb div1(Limb a);
+    void monpro(Asi &x, Asi &y, Asi &n, Asi &t, Limb n0);
     void powqmod(Asi &a, Asi &b, Asi &mod, Asi &t);
     void pow2mod(Asi &a, Asi &b, Uint size, Asi &t);
 
-    static Uint wordinv(Uint n);
+    static Limb wordinv(Limb n);
+    static Montgomery *montgomery(Asi &mod, Asi &t);
+
+    static Montgomery mcache[MONTCACHE];
 };
 
+Asi::Montgomery Asi::mcache[MONTCACHE];
+
 /*
  * copy number
  */
 void Asi::copy(Asi &x)
 {
     size = x.size;
-    memmove(num, x.num, size * sizeof(Uint));
+    memmove(num, x.num, size * sizeof(Limb));
 }
 
 /*
@@ -77,7 +112,8 @@ void Asi::copy(Asi &x)
  */
 bool Asi::add(Asi &x)
 {
-    Uint *a, *b, sz, tmp, carry;
+    Limb *a, *b, tmp, carry;
+    Uint sz;
 
     a = num;
     b = x.num;
@@ -100,7 +136,8 @@ bool Asi::add(Asi &x)
  */
 bool Asi::sub(Asi &x)
 {
-    Uint *a, *b, sz, tmp, borrow;
+    Limb *a, *b, tmp, borrow;
+    Uint sz;
 
     a = num;
     b = x.num;
@@ -123,22 +160,23 @@ bool Asi::sub(Asi &x)
  */
 void Asi::lshift(Uint lshift)
 {
-    Uint offset, *a, sz, rshift, tmp, bits;
+    Uint offset, sz, rshift, i;
+    Limb *a, tmp, bits;
 
-    offset = (lshift + 31) >> 5;
-    lshift &= 0x1f;
+    offset = (lshift + LIMB_MASK) >> LIMB_SHIFT;
+    lshift &= LIMB_MASK;
     a = num;
     sz = size - offset;
 
     if (lshift == 0) {
 	a += sz;
-	for (tmp = sz; tmp > 0; --tmp) {
+	for (i = sz; i > 0; --i) {
 	    --a;
 	    a[offset] = *a;
 	}
 	bits = 0;
     } else {
-	rshift = 32 - lshift;
+	rshift = LIMB_BITS - lshift;
 	a += sz;
 	bits = *a << lshift;
 	while (sz != 0) {
@@ -161,21 +199,22 @@ void Asi::lshift(Uint lshift)
  */
 void Asi::rshift(Uint rshift)
 {
-    Uint offset, *a, sz, lshift, tmp, bits;
+    Uint offset, sz, lshift, i;
+    Limb *a, tmp, bits;
 
-    offset = (rshift + 31) >> 5;
-    rshift &= 0x1f;
+    offset = (rshift + LIMB_MASK) >> LIMB_SHIFT;
+    rshift &= LIMB_MASK;
     a = num;
     sz = size - offset;
 
     if (rshift == 0) {
-	for (tmp = sz; tmp > 0; --tmp) {
+	for (i = sz; i > 0; --i) {
 	    *a = a[offset];
 	    a++;
 	}
 	bits = 0;
     } else {
-	lshift = 32 - rshift;
+	lshift = LIMB_BITS - rshift;
 	bits = a[offset - 1] >> rshift;
 	while (sz != 0) {
 	    tmp = a[offset];
@@ -196,7 +235,8 @@ void Asi::rshift(Uint rshift)
  */
 int Asi::cmp(Asi &x)
 {
-    Uint *a, sz, *b;
+    Limb *a, *b;
+    Uint sz;
 
     sz = size;
     a = num + sz;
@@ -219,55 +259,19 @@ int Asi::cmp(Asi &x)
     return 0;
 }
 
-/*
- * a * b
- */
-void Asi::mult1(Uint a, Uint b)
-{
-# ifdef Uuint
-    Uuint t;
-
-    t = (Uuint) (a) * (b);
-    num[0] = t;
-    num[1] = t >> 32;
-# else
-    unsigned short a0, a1, b0, b1;
-    Uint t0, t1;
-
-    a0 = a;
-    a1 = a >> 16;
-    b0 = b;
-    b1 = b >> 16;
-
-    t0 = (Uint) a0 * b1;
-    t1 = (Uint) a1 * b0;
-    t1 = ((t0 += t1) < t1);
-    t1 = (t1 << 16) | (t0 >> 16);
-    t0 <<= 16;
-    if ((num[0] = (Uint) a0 * b0 + t0) < t0) {
-	t1++;
-    }
-    num[1] = (Uint) a1 * b1 + t1;
-# endif
-    size = 2;
-}
-
 /*
  * compute x * y (x.size - y.size <= 1)
  * t.size = (x.size + y.size) << 1
  */
 void Asi::multInner(Asi &x, Asi &y, Asi &t)
 {
-    if (y.size == 1) {
-	/* x.size <= 2, y.size == 1 */
-	mult1(x.num[0], y.num[0]);
-	if (x.size > 1) {
-	    /* x.size == 2, y.size == 1 */
-	    t.mult1(x.num[1], y.num[0]);
-	    if ((num[1] += t.num[0]) < t.num[0]) {
-		t.num[1]++;
-	    }
-	    num[2] = t.num[1];
+    if (y.size < KMULTSZ) {
+	Uint i;
+
+	/* schoolbook multiplication */
+	memset(num, '\0', (x.size + y.size) * sizeof(Limb));
+	for (i = 0; i < y.size; i++) {
+	    Asi(num + i, x.size + 1).multRow(x, y.num[i]);
 	}
     } else {
 	Asi x0(x.num, x.size >> 1);
@@ -352,7 +356,7 @@ void Asi::mult(Asi &x, Asi &y, Asi &t1)
     Asi z(num, size = a.size + b.size);
     Asi t2(t1.num + size, 0);
 
-    memset(num, '\0', size * sizeof(Uint));
+    memset(num, '\0', size * sizeof(Limb));
     while (a.size != b.size) {
 	if (a.size < b.size) {
 	    Asi t = a;
@@ -365,71 +369,37 @@ void Asi::mult(Asi &x, Asi &y, Asi &t1)
 
 	Asi c(a.num, b.size);
 	t1.multInner(c, b, t2);
-	z.size = t1.size;
+	z.size = num + size - z.num;
 	z.add(t1);
 	a.num += b.size;
 	a.size -= b.size;
 	z.num += b.size;
     }
     t1.multInner(a, b, t2);
-    z.size = t1.size;
+    z.size = num + size - z.num;
     z.add(t1);
 }
 
 /*
  * add x * word
  */
-bool Asi::multRow(Asi &x, Uint y)
+bool Asi::multRow(Asi &x, Limb y)
 {
-    Uint *a, *b, sz, s, carry;
-    Uint tmp[2];
-    Asi t(tmp, 2);
+    Limb *a, *b, carry;
+    Uint sz;
+    Dlimb t;
 
     a = num;
     b = x.num;
     sz = x.size;
-    s = 0;
     carry = 0;
     do {
-	t.mult1(*b++, y);
-	if ((s += t.num[0]) < t.num[0]) {
-	    t.num[1]++;
-	}
-	carry = ((s += carry) < carry);
-	carry += ((*a++ += s) < s);
-	s = t.num[1];
+	t = (Dlimb) *b++ * y + *a + carry;
+	*a++ = (Limb) t;
+	carry = (Limb) (t >> LIMB_BITS);
     } while (--sz != 0);
 
-    carry = ((s += carry) < carry);
-    return (bool) (carry + ((*a += s) < s));
-}
-
-void Asi::sqr1(Uint a)
-{
-# ifdef Uuint
-    Uuint t;
-
-    t = (Uuint) a * a;
-    num[0] = t;
-    num[1] = t >> 32;
-# else
-    unsigned short a0, a1;
-    Uint t0, t1;
-
-    a0 = a;
-    a1 = a >> 16;
-
-    t0 = (Uint) a0 * a1;
-    t1 = t0;
-    t1 = ((t0 <<= 1) < t1);
-    t1 = (t1 << 16) | (t0 >> 16);
-    t0 <<= 16;
-    if ((num[0] = (Uint) a0 * a0 + t0) < t0) {
-	t1++;
-    }
-    num[1] = (Uint) a1 * a1 + t1;
-# endif
-    size = 2;
+    return ((*a += carry) < carry);
 }
 
 /*
@@ -438,8 +408,34 @@ void Asi::sqr1(Uint a)
  */
 void Asi::sqr(Asi &x, Asi &t)
 {
-    if (x.size == 1) {
-	sqr1(x.num[0]);
+    if (x.size < KMULTSZ) {
+	Uint i, sz;
+	Limb *a, carry, bits, sq;
+	Dlimb d;
+
+	/* cross products, counted once */
+	sz = x.size << 1;
+	memset(num, '\0', sz * sizeof(Limb));
+	for (i = 1; i < x.size; i++) {
+	    Asi y(x.num + i, x.size - i);
+	    Asi(num + (i << 1) - 1, y.size + 1).multRow(y, x.num[i - 1]);
+	}
+
+	/* double them, and add the squares */
+	a = num;
+	carry = 0;
+	bits = 0;
+	for (i = 0; i < x.size; i++) {
+	    d = (Dlimb) x.num[i] * x.num[i];
+	    sq = (Limb) (d >> LIMB_BITS);
+	    d = (Dlimb) ((a[0] << 1) | bits) + (Limb) d + carry;
+	    bits = a[0] >> LIMB_MASK;
+	    *a++ = (Limb) d;
+	    d = (Dlimb) ((a[0] << 1) | bits) + sq + (Limb) (d >> LIMB_BITS);
+	    bits = a[0] >> LIMB_MASK;
+	    *a++ = (Limb) d;
+	    carry = (Limb) (d >> LIMB_BITS);
+	}
     } else {
 	Asi x0(x.num, x.size >> 1);
 	Asi x1(x.num + x0.size, x.size - x0.size);
@@ -477,59 +473,22 @@ void Asi::sqr(Asi &x, Asi &t)
     size = x.size << 1;
 }
 
-Uint Asi::div1(Uint a)
+/*
+ * divide a double limb by a (num[1] < a)
+ */
+Limb Asi::div1(Limb a)
 {
-# ifdef Uuint
-    return (((Uuint) num[1] << 32) | num[0]) / a;
-# else
-    Uint q1, q0;
-    Uint b[2], c[2], tmp[2];
-    Asi x(b, 2);
-    Asi y(c, 2);
-    Asi z(&a, 1);
-    Asi t(tmp, 2);
-
-    x.copy(*this);
-
-    q1 = ((x.num[1] ^ a) >> 16 == 0) ?
-	  0xffff : x.num[1] / (unsigned short) (a >> 16);
-    t.mult1(a, q1 << 16);
-    if (t.cmp(x) > 0) {
-	y.num[0] = a << 16;
-	y.num[1] = a >> 16;
-	t.sub(y);
-	--q1;
-	if (t.cmp(x) > 0) {
-	    t.sub(y);
-	    --q1;
-	}
-    }
-    x.sub(t);
-
-    q0 = (x.num[1] == a >> 16) ?
-	  0xffff :
-	  ((x.num[1] << 16) | (x.num[0] >> 16)) / (unsigned short) (a >> 16);
-    t.mult1(a, q0);
-    if (t.cmp(x) > 0) {
-	t.sub(z);
-	--q0;
-	if (t.cmp(x) > 0) {
-	    t.sub(z);
-	    --q0;
-	}
-    }
-
-    return (q1 << 16) | q0;
-# endif
+    return (Limb) ((((Dlimb) num[1] << LIMB_BITS) | num[0]) / a);
 }
 
 /*
  * z1 = x / y, z0 = x % y (x >= y, y != 0)
  * t.size = (y.size << 1) + 1
  */
-Uint *Asi::div(Asi &x, Asi &y, Asi &t)
+Limb *Asi::div(Asi &x, Asi &y, Asi &t)
 {
-    Uint d, q, shift;
+    Limb d, q;
+    Uint shift;
     Asi a(num, size);
     Asi b(t.num, y.size);
     Asi t2(t.num + b.size, b.size + 1);
@@ -544,7 +503,7 @@ Uint *Asi::div(Asi &x, Asi &y, Asi &t)
     /*
      * left shift until most significant bit of b is 1
      */
-    for (shift = 0, d = b.num[b.size - 1]; !(d & 0x80000000L); shift++, d <<= 1)
+    for (shift = 0, d = b.num[b.size - 1]; !(d & LIMB_MSB); shift++, d <<= 1)
 	;
     if (shift != 0) {
 	b.lshift(shift);
@@ -578,11 +537,11 @@ Uint *Asi::div(Asi &x, Asi &y, Asi &t)
 	d = b.num[b.size - 1];
 	do {
 	    if (a.num[b.size] == d) {
-		q = 0xffffffffL;
+		q = LIMB_MAX;
 	    } else {
 		q = Asi(a.num + b.size - 1, 2).div1(d);
 	    }
-	    memset(t2.num, '\0', t2.size * sizeof(Uint));
+	    memset(t2.num, '\0', t2.size * sizeof(Limb));
 	    t2.multRow(b, q);
 	    if (t2.cmp(a) > 0) {
 		t2.sub(b);
@@ -630,23 +589,23 @@ bool Asi::modinv(Asi &x, Asi &y)
     }
 
     /* b1 * b - a1 * a = b */
-    Asi b1(ALLOCA(Uint, a.size + b.size), 1);		/* b1 = 1 */
-    memset(b1.num, '\0', (a.size + b.size) * sizeof(Uint));
+    Asi b1(ALLOCA(Limb, a.size + b.size), 1);		/* b1 = 1 */
+    memset(b1.num, '\0', (a.size + b.size) * sizeof(Limb));
     b1.num[0] = 1;
     b1.size = 1;
-    Asi a1(ALLOCA(Uint, a.size + b.size), 1);		/* a1 = 0 */
-    memset(a1.num, '\0', (a.size + b.size) * sizeof(Uint));
+    Asi a1(ALLOCA(Limb, a.size + b.size), 1);		/* a1 = 0 */
+    memset(a1.num, '\0', (a.size + b.size) * sizeof(Limb));
     a1.size = 1;
-    Asi g1(ALLOCA(Uint, b.size), 0);			/* g1 = b */
+    Asi g1(ALLOCA(Limb, b.size), 0);			/* g1 = b */
     g1.copy(b);
 
     /* b2 * b - a2 * a = a */
-    Asi b2(ALLOCA(Uint, a.size + b.size), 0);		/* b2 = a */
+    Asi b2(ALLOCA(Limb, a.size + b.size), 0);		/* b2 = a */
     b2.copy(a);
-    memset(b2.num + a.size, '\0', b.size * sizeof(Uint));
-    Asi a2(ALLOCA(Uint, a.size + b.size), 0);		/* a2 = b - 1 */
+    memset(b2.num + a.size, '\0', b.size * sizeof(Limb));
+    Asi a2(ALLOCA(Limb, a.size + b.size), 0);		/* a2 = b - 1 */
     a2.copy(b);
-    memset(a2.num + b.size, '\0', a.size * sizeof(Uint));
+    memset(a2.num + b.size, '\0', a.size * sizeof(Limb));
     a2.sub(b1);
     while (a2.num[a2.size - 1] == 0) {
 	if (--a2.size == 0) {
@@ -654,7 +613,7 @@ bool Asi::modinv(Asi &x, Asi &y)
 	    break;
 	}
     }
-    Asi g2(ALLOCA(Uint, a.size), 0);			/* g2 = a */
+    Asi g2(ALLOCA(Limb, a.size), 0);			/* g2 = a */
     g2.copy(a);
 
     do {
@@ -782,6 +741,7 @@ bool Asi::modinv(Asi &x, Asi &y)
     return inverse;
 }
 
+
 /*
  * The algorithms for fast exponentiation are based on:
  * "High-Speed RSA Implementation" by Çetin Koya Koç, Version 2.0,
@@ -789,33 +749,76 @@ bool Asi::modinv(Asi &x, Asi &y)
  */
 
 /*
- * compute an inverse modulo the word size (for odd n)
+ * compute an inverse modulo the limb size (for odd n)
  */
-Uint Asi::wordinv(Uint n)
+Limb Asi::wordinv(Limb n)
 {
-    Uint n1, mask, i;
+    Limb n1;
+    Uint bits;
 
-    n1 = 1;
-    mask = 0x3;
-    i = 0x2;
-    do {
-	if (((n * n1) & mask) > i) {
-	    n1 += i;
-	}
-	i <<= 1;
-	mask |= i;
-    } while (i != 0);
+    /* n is its own inverse modulo 8; each step doubles the precision */
+    n1 = n;
+    for (bits = 3; bits < LIMB_BITS; bits <<= 1) {
+	n1 *= 2 - n * n1;
+    }
 
     return n1;
 }
 
+/*
+ * find the Montgomery context for an odd modulus, creating it if needed;
+ * the most recently used contexts are kept at the front of the cache
+ * t.size = (mod.size << 1) + 1
+ */
+Asi::Montgomery *Asi::montgomery(Asi &mod, Asi &t)
+{
+    Montgomery m;
+    Uint i;
+
+    for (i = 0; i < MONTCACHE && mcache[i].mod != (Limb *) NULL; i++) {
+	if (mcache[i].size == mod.size && mcache[i].mod[0] == mod.num[0] &&
+	    memcmp(mcache[i].mod, mod.num, mod.size * sizeof(Limb)) == 0) {
+	    m = mcache[i];
+	    memmove(mcache + 1, mcache, i * sizeof(Montgomery));
+	    mcache[0] = m;
+	    return mcache;
+	}
+    }
+
+    if (i == MONTCACHE) {
+	/* evict the least recently used context */
+	FREE(mcache[--i].mod);
+    }
+    memmove(mcache + 1, mcache, i * sizeof(Montgomery));
+
+    MM->staticMode();
+    m.mod = ALLOC(Limb, mod.size << 1);
+    MM->dynamicMode();
+    m.r2 = m.mod + mod.size;
+    memcpy(m.mod, mod.num, mod.size * sizeof(Limb));
+    m.size = mod.size;
+    m.n0 = -wordinv(mod.num[0]);
+
+    /* r2 = R ** 2 % mod */
+    Asi r(ALLOCA(Limb, (mod.size << 1) + 3), (mod.size << 1) + 1);
+    memset(r.num, '\0', (mod.size << 1) * sizeof(Limb));
+    r.num[mod.size << 1] = 1;
+    r.div(r, mod, t);
+    memcpy(m.r2, r.num, mod.size * sizeof(Limb));
+    AFREE(r.num);
+
+    mcache[0] = m;
+    return mcache;
+}
+
 /*
  * compute the Montgomery product of a and b
  * t.size = (size + 1) << 1
  */
-void Asi::monpro(Asi &x, Asi &y, Asi &n, Asi &t, Uint n0)
+void Asi::monpro(Asi &x, Asi &y, Asi &n, Asi &t, Limb n0)
 {
-    Uint i, j, m, *d, carry;
+    Uint i, j;
+    Limb m, *d, carry;
 
     if (x.num == y.num) {
 	sqr(x, t);
@@ -841,130 +844,133 @@ void Asi::monpro(Asi &x, Asi &y, Asi &n, Asi &t, Uint n0)
     }
 }
 
-# define WINDOWSZ	6
+# define BIT(b, i)	(((b).num[(i) >> LIMB_SHIFT] >> ((i) & LIMB_MASK)) & 1)
 
 /*
- * compute a ** b % mod (a > 1, b > 1, (mod & 1) != 0)
+ * compute a ** b % mod (a > 1, b > 1, (mod & 1) != 0), using a sliding
+ * window over the exponent
  * t.size = (mod.size + 1) << 1
  */
 void Asi::powqmod(Asi &a, Asi &b, Asi &mod, Asi &t)
 {
-    Uint bit, e, window, wsize, zsize, n0;
-    Asi tab[1 << WINDOWSZ];
-
-    /* allocate */
-    Asi x(ALLOCA(Uint, (mod.size << 1) + 1), 0);
-    Asi xx(x.num + mod.size, 0);
-    Asi y(ALLOCA(Uint, (mod.size << 1) + a.size + 1), mod.size + a.size);
-    Asi yy(y.num + mod.size, 0);
-
-    /* xx = a * R % mod */
-    memset(y.num, '\0', mod.size * sizeof(Uint));
-    yy.copy(a);
-    y.div(y, mod, t);
-    xx.copy(y);
-
-    /* tab[] = { powers of xx } */
-    tab[0] = xx;	/* sentinel */
-    tab[1] = Asi(ALLOCA(Uint, mod.size), 0);
-    tab[1].copy(xx);
-
-    n0 = -wordinv(mod.num[0]);
-    window = wsize = zsize = 0;
-    size = b.size;
-    e = b.num[size - 1];
-    for (bit = 0x80000000L; (e & bit) == 0; bit >>= 1) ;
-    bit >>= 1;	/* skip most significant bit of top word */
-
-    for (;;) {
-	while (bit != 0) {
-	    if (wsize == WINDOWSZ || (zsize != 0 && !(e & bit))) {
-		y.monpro(xx, tab[window], mod, t, n0);
-		window = wsize = zsize = 0;
-	    } else {
-		window <<= 1;
-		if (tab[window].num == (Uint *) NULL) {
-		    y.monpro(tab[window >> 1], tab[window >> 1], mod, t, n0);
-		    tab[window] = Asi(ALLOCA(Uint, mod.size), 0);
-		    tab[window].copy(yy);
-		}
-		yy.copy(xx);
-	    }
+    Montgomery *m;
+    Uint nbits, wsize, i, j, window;
+    Limb e, n0;
+    bool first;
 
-	    x.monpro(yy, yy, mod, t, n0);
+    m = montgomery(mod, t);
+    n0 = m->n0;
+    Asi r2(m->r2, mod.size);
 
-	    if (e & bit) {
-		window |= 1;
-		if (tab[window].num == (Uint *) NULL) {
-		    y.monpro(tab[window - 1], tab[1], mod, t, n0);
-		    tab[window] = Asi(ALLOCA(Uint, mod.size), 0);
-		    tab[window].copy(yy);
-		}
-		zsize = 0;
-		wsize++;
-	    } else if (wsize != 0) {
-		zsize++;
-		wsize++;
-	    }
-
-	    bit >>= 1;
-	}
+    /* window size, depending on the number of bits in the exponent */
+    nbits = b.size << LIMB_SHIFT;
+    for (e = b.num[b.size - 1]; !(e & LIMB_MSB); e <<= 1) {
+	--nbits;
+    }
+    wsize = (nbits > 671) ? 6 : (nbits > 239) ? 5 : (nbits > 79) ? 4 :
+	    (nbits > 23) ? 3 : 1;
 
-	if (--size == 0) {
-	    break;
-	}
-	/* next word in exponent */
-	e = b.num[size - 1];
-	bit = 0x80000000L;
+    /* allocate */
+    Asi x(ALLOCA(Limb, (mod.size << 1) + 1), 0);
+    Asi xx(x.num + mod.size, mod.size);
+    Asi y(ALLOCA(Limb, mod.size), mod.size);
+    Asi tab(ALLOCA(Limb, mod.size << (wsize - 1)), mod.size);
+
+    /* tab[0] = a * R % mod */
+    if (a.size < mod.size || (a.size == mod.size && a.cmp(mod) < 0)) {
+	y.copy(a);
+	memset(y.num + a.size, '\0', (mod.size - a.size) * sizeof(Limb));
+	y.size = mod.size;
+    } else {
+	Asi z(ALLOCA(Limb, a.size + 2), 0);
+	z.div(a, mod, t);
+	y.copy(z);
+	AFREE(z.num);
     }
+    x.monpro(y, r2, mod, t, n0);
+    tab.copy(xx);
 
-    if (wsize != 0) {
-	/*
-	 * still a remaining window of bits to deal with
-	 */
-	y.monpro(xx, tab[window], mod, t, n0);
-	xx.copy(yy);
+    /* tab[] = { odd powers of tab[0] } */
+    if (wsize > 1) {
+	x.monpro(tab, tab, mod, t, n0);
+	y.copy(xx);
+	for (i = 1; i < (Uint) 1 << (wsize - 1); i++) {
+	    Asi prev(tab.num + (i - 1) * mod.size, mod.size);
+	    x.monpro(prev, y, mod, t, n0);
+	    memcpy(tab.num + i * mod.size, xx.num, mod.size * sizeof(Limb));
+	}
     }
 
-    /* c = xx * (R ** -1) */
-    memset(tab[1].num, '\0', mod.size * sizeof(Uint));
-    tab[1].num[0] = 1;
-    y.monpro(xx, tab[1], mod, t, n0);
-    copy(yy);
+    first = TRUE;
+    i = nbits;
+    do {
+	if (!BIT(b, i - 1)) {
+	    x.monpro(y, y, mod, t, n0);
+	    y.copy(xx);
+	    --i;
+	} else {
+	    /* the longest window of at most wsize bits that ends in a 1 */
+	    j = (i > wsize) ? i - wsize : 0;
+	    while (!BIT(b, j)) {
+		j++;
+	    }
+	    window = 0;
+	    do {
+		window = (window << 1) | BIT(b, i - 1);
+		if (!first) {
+		    x.monpro(y, y, mod, t, n0);
+		    y.copy(xx);
+		}
+	    } while (--i > j);
 
-    for (window = 1 << WINDOWSZ; --window != 0; ) {
-	if (tab[window].num != (Uint *) NULL) {
-	    AFREE(tab[window].num);
+	    Asi w(tab.num + (window >> 1) * mod.size, mod.size);
+	    if (first) {
+		y.copy(w);
+		first = FALSE;
+	    } else {
+		x.monpro(y, w, mod, t, n0);
+		y.copy(xx);
+	    }
 	}
-    }
+    } while (i != 0);
+
+    /* c = y * (R ** -1) */
+    memset(tab.num, '\0', mod.size * sizeof(Limb));
+    tab.num[0] = 1;
+    x.monpro(y, tab, mod, t, n0);
+    copy(xx);
+
+    AFREE(tab.num);
     AFREE(y.num);
     AFREE(x.num);
 }
 
 /*
- * compute a ** b, (all operations in size words)
+ * compute a ** b, (all operations in size limbs)
  * t.size = (size + 1) << 1
  */
 void Asi::pow2mod(Asi &a, Asi &b, Uint size, Asi &t)
 {
-    Uint e, bit, sizeb;
-    Asi x(ALLOCA(Uint, size), size);
-    Asi y(ALLOCA(Uint, size << 1), 0);
-    Asi z(ALLOCA(Uint, size << 1), 0);
+    Limb e, bit;
+    Uint sizeb;
+    Asi x(ALLOCA(Limb, size), size);
+    Asi y(ALLOCA(Limb, size << 1), 0);
+    Asi z(ALLOCA(Limb, size << 1), 0);
 
-    /* x = a reduced to size words */
+    /* x = a reduced to size limbs */
     if (a.size >= size) {
-	memcpy(x.num, a.num, size * sizeof(Uint));
+	memcpy(x.num, a.num, size * sizeof(Limb));
     } else {
-	memcpy(x.num, a.num, a.size * sizeof(Uint));
-	memset(x.num + a.size, '\0', (size - a.size) * sizeof(Uint));
+	memcpy(x.num, a.num, a.size * sizeof(Limb));
+	memset(x.num + a.size, '\0', (size - a.size) * sizeof(Limb));
     }
 
     /* remove leading zeroes from b */
-    for (sizeb = size; b.num[sizeb - 1] == 0; --sizeb) {
+    for (sizeb = (b.size < size) ? b.size : size; b.num[sizeb - 1] == 0;
+	 --sizeb) {
 	if (sizeb == 1) {
 	    /* a ** 0 = 1 */
-	    memset(num, '\0', size * sizeof(Uint));
+	    memset(num, '\0', size * sizeof(Limb));
 	    num[0] = 1;
 	    this->size = size;
 	    return;
@@ -973,8 +979,8 @@ void Asi::pow2mod(Asi &a, Asi &b, Uint size, Asi &t)
 
     y.copy(x);
     e = b.num[sizeb - 1];
-    for (bit = 0x80000000L; (e & bit) == 0; bit >>= 1) ;
-    bit >>= 1;	/* skip most significant bit of top word */
+    for (bit = LIMB_MSB; (e & bit) == 0; bit >>= 1) ;
+    bit >>= 1;	/* skip most significant bit of top limb */
 
     for (;;) {
 	while (bit != 0) {
@@ -992,9 +998,9 @@ void Asi::pow2mod(Asi &a, Asi &b, Uint size, Asi &t)
 	if (--sizeb == 0) {
 	    break;
 	}
-	/* next word in exponent */
+	/* next limb in exponent */
 	e = b.num[sizeb - 1];
-	bit = 0x80000000L;
+	bit = LIMB_MSB;
     }
 
     copy(y);
@@ -1037,38 +1043,42 @@ void Asi::power(Asi &a, Asi &b, Asi &mod, Asi &t)
 	 */
 	powqmod(a, b, mod, t);
     } else {
-	Uint i;
+	Uint sz, j;
+	Limb mask;
 	bool minus;
 
 	/*
 	 * modulo even number
 	 */
-	Asi x(ALLOCA(Uint, mod.size), 0);
-	Asi y(ALLOCA(Uint, mod.size + 1), 0);
-	Asi z(ALLOCA(Uint, mod.size << 1), 0);
-	Asi q(ALLOCA(Uint, mod.size), 0);
-	Asi qinv(ALLOCA(Uint, mod.size), 0);
+	Asi x(ALLOCA(Limb, mod.size), 0);
+	Asi y(ALLOCA(Limb, mod.size + 1), 0);
+	Asi z(ALLOCA(Limb, mod.size << 1), 0);
+	Asi q(ALLOCA(Limb, mod.size), 0);
+	Asi qinv(ALLOCA(Limb, mod.size), 0);
 
-	/* j = (size << 5) + i = number of least significant zero bits */
-	for (size = 0; mod.num[size] == 0; size++) ;
-	for (i = 0; !(mod.num[size] & (1 << i)); i++) ;
+	/* (sz << LIMB_SHIFT) + j = number of least significant zero bits */
+	for (sz = 0; mod.num[sz] == 0; sz++) ;
+	for (j = 0; !(mod.num[sz] & ((Limb) 1 << j)); j++) ;
 
 	/* q = mod >> j */
 	q.copy(mod);
-	q.rshift((size << 5) + i);
+	q.rshift((sz << LIMB_SHIFT) + j);
+	while (q.num[q.size - 1] == 0) {
+	    --q.size;
+	}
 
-	/* size = number of words, i = mask */
-	if (i != 0) {
-	    i = 0xffffffffL >> (32 - i);
-	    size++;
+	/* sz = number of limbs */
+	if (j != 0) {
+	    mask = LIMB_MAX >> (LIMB_BITS - j);
+	    sz++;
 	} else {
-	    i = 0xffffffffL;
+	    mask = LIMB_MAX;
 	}
 
 	/* y = a ** b % 2 ** j */
-	y.pow2mod(a, b, size, t);
-	y.num[size - 1] &= i;
-	y.size = size;
+	y.pow2mod(a, b, sz, t);
+	y.num[sz - 1] &= mask;
+	y.size = sz;
 
 	if (q.size != 1 || q.num[0] != 1) {
 	    x.powqmod(a, b, q, t);
@@ -1076,41 +1086,41 @@ void Asi::power(Asi &a, Asi &b, Asi &mod, Asi &t)
 	    /*
 	     * y = x + q * ((y - x) * q ** -1 % 2 ** j)
 	     */
-	    if (size >= q.size && y.cmp(x) >= 0) {
+	    if (sz >= q.size && y.cmp(x) >= 0) {
 		/* y - x */
 		y.sub(x);
 		minus = FALSE;
 	    } else {
 		/* x - y */
 		t.copy(x);
-		if (size > t.size) {
+		if (sz > t.size) {
 		    memset(t.num + t.size, '\0',
-			   (size - t.size) * sizeof(Uint));
+			   (sz - t.size) * sizeof(Limb));
 		}
-		t.size = size;
+		t.size = sz;
 		t.sub(y);
 		y.copy(t);
 		minus = TRUE;
 	    }
 	    /* q ** -1 */
-	    if (size == 1) {
+	    if (sz == 1) {
 		qinv.num[0] = wordinv(q.num[0]);
 		qinv.size = 1;
 	    } else {
-		memset(z.num, '\0', size * sizeof(Uint));
-		if (i == 0xffffffffL) {
-		    z.num[size] = 1;
-		    z.size = size + 1;
+		memset(z.num, '\0', sz * sizeof(Limb));
+		if (mask == LIMB_MAX) {
+		    z.num[sz] = 1;
+		    z.size = sz + 1;
 		} else {
-		    z.num[size - 1] = i + 1;
-		    z.size = size;
+		    z.num[sz - 1] = mask + 1;
+		    z.size = sz;
 		}
 		qinv.modinv(q, z);
 	    }
 	    /* (y - x) * q ** -1 % 2 ** j */
 	    z.multInner(y, qinv, t);
-	    z.num[size - 1] &= i;
-	    z.size = size;
+	    z.num[sz - 1] &= mask;
+	    z.size = sz;
 	    /* q * ((y - x) * q ** -1 % 2 ** j) */
 	    y.mult(q, z, t);
 	    y.size = mod.size;
@@ -1118,7 +1128,7 @@ void Asi::power(Asi &a, Asi &b, Asi &mod, Asi &t)
 		/* x - q * ((y - x) * q ** -1 % 2 ** j) */
 		if (y.cmp(x) <= 0) {
 		    memset(x.num + x.size, '\0',
-			   (y.size - x.size) * sizeof(Uint));
+			   (y.size - x.size) * sizeof(Limb));
 		    x.size = y.size;
 		    x.sub(y);
 		    y.copy(x);
@@ -1154,7 +1164,8 @@ bool Asi::strtonum(String *str)
 {
     ssizet len;
     char *text;
-    Uint *tmp, bits;
+    Limb *tmp, bits;
+    int i;
 
     len = str->len;
     text = str->text;
@@ -1180,22 +1191,23 @@ bool Asi::strtonum(String *str)
 		return TRUE;
 	    }
 	}
-	size = (len + 3) / sizeof(Uint);
-	memset(num, '\0', (size + 1) * sizeof(Uint));
+	size = (len + LIMB_BYTES - 1) / LIMB_BYTES;
+	memset(num, '\0', (size + 1) * sizeof(Limb));
 
-	tmp = ALLOCA(Uint, size);
+	tmp = ALLOCA(Limb, size);
 	text += len;
-	while (len >= 4) {
-	    text -= 4;
-	    *tmp++ = (UCHAR(text[0]) << 24) |
-		     (UCHAR(text[1]) << 16) |
-		     (UCHAR(text[2]) << 8) |
-		     UCHAR(text[3]);
-	    len -= 4;
+	while (len >= LIMB_BYTES) {
+	    text -= LIMB_BYTES;
+	    bits = 0;
+	    for (i = 0; i < LIMB_BYTES; i++) {
+		bits = (bits << 8) | UCHAR(text[i]);
+	    }
+	    *tmp++ = bits;
+	    len -= LIMB_BYTES;
 	}
 	if (len != 0) {
 	    text -= len;
-	    bits = 0xffffffffL;
+	    bits = LIMB_MAX;
 	    do {
 		bits = (bits << 8) | UCHAR(*text++);
 	    } while (--len != 0);
@@ -1222,18 +1234,19 @@ bool Asi::strtonum(String *str)
 		return FALSE;
 	    }
 	}
-	size = (len + 3) / sizeof(Uint);
+	size = (len + LIMB_BYTES - 1) / LIMB_BYTES;
 	num[size] = 0;
 
 	tmp = num;
 	text += len;
-	while (len >= 4) {
-	    text -= 4;
-	    *tmp++ = (UCHAR(text[0]) << 24) |
-		     (UCHAR(text[1]) << 16) |
-		     (UCHAR(text[2]) << 8) |
-		     UCHAR(text[3]);
-	    len -= 4;
+	while (len >= LIMB_BYTES) {
+	    text -= LIMB_BYTES;
+	    bits = 0;
+	    for (i = 0; i < LIMB_BYTES; i++) {
+		bits = (bits << 8) | UCHAR(text[i]);
+	    }
+	    *tmp++ = bits;
+	    len -= LIMB_BYTES;
 	}
 	if (len != 0) {
 	    text -= len;
@@ -1253,11 +1266,10 @@ bool Asi::strtonum(String *str)
  */
 String *Asi::numtostr(bool minus)
 {
-    Uint *n, sz;
+    Limb *n, *tmp, bits;
+    Uint sz;
     ssizet len;
-    Uint bits;
     char *text;
-    Uint *tmp;
     bool prefix;
     String *str;
 
@@ -1276,19 +1288,20 @@ String *Asi::numtostr(bool minus)
 
     prefix = FALSE;
     if (minus) {
-	tmp = ALLOCA(Uint, sz);
-	memset(tmp, '\0', sz * sizeof(Uint));
+	tmp = ALLOCA(Limb, sz);
+	memset(tmp, '\0', sz * sizeof(Limb));
 	Asi t(tmp, sz);
 	t.sub(*this);
 	copy(t);
 
 	n += --sz;
 	bits = *n;
-	if (sz == 0 && bits == 0xffffffffL) {
+	if (sz == 0 && bits == LIMB_MAX) {
 	    len = 0;
 	} else {
 	    /* skip leading 0xff bytes */
-	    for (len = 24; UCHAR(bits >> len) == 0xff; len -= 8) ;
+	    for (len = LIMB_BITS - 8; len != 0 && UCHAR(bits >> len) == 0xff;
+		 len -= 8) ;
 	    if (!((bits >> len) & 0x80)) {
 		prefix = TRUE;
 	    }
@@ -1297,7 +1310,7 @@ String *Asi::numtostr(bool minus)
 	/* skip leading 0x00 bytes */
 	n += --sz;
 	bits = *n;
-	for (len = 24; (bits >> len) == 0; len -= 8) ;
+	for (len = LIMB_BITS - 8; (bits >> len) == 0; len -= 8) ;
 	if ((bits >> len) & 0x80) {
 	    prefix = TRUE;
 	}
@@ -1305,7 +1318,7 @@ String *Asi::numtostr(bool minus)
     len = (len >> 3) + 1;
 
     str = String::create((char *) NULL,
-			 (long) sz * sizeof(Uint) + len + prefix);
+			 (long) sz * LIMB_BYTES + len + prefix);
     text = str->text;
     if (prefix) {
 	/* extra sign indicator */
@@ -1316,10 +1329,10 @@ String *Asi::numtostr(bool minus)
     } while (len != 0);
     while (sz != 0) {
 	bits = *--n;
-	*text++ = bits >> 24;
-	*text++ = bits >> 16;
-	*text++ = bits >> 8;
-	*text++ = bits;
+	for (len = LIMB_BITS; len != 0; ) {
+	    len -= 8;
+	    *text++ = bits >> len;
+	}
 	--sz;
     }
 
@@ -1354,17 +1367,17 @@ String *ASN::add(Frame *f, String *s1, String *s2, String *s3)
     bool minusa, minusb, minusc;
     String *str;
 
-    Asi mod(ALLOCA(Uint, (s3->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s3->len) + 2), 0);
     if (mod.strtonum(s3) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 4), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 4), 0);
     minusa = a.strtonum(s1);
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 4), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 4), 0);
     minusb = b.strtonum(s2);
-    i_add_ticks(f, 4 + ((a.size + b.size + mod.size) >> 1));
+    i_add_ticks(f, 4 + (WORDS(a.size + b.size + mod.size) >> 1));
 
     if (minusa != minusb) {
 	if (a.size > b.size || (a.size == b.size && a.cmp(b) >= 0)) {
@@ -1395,13 +1408,13 @@ String *ASN::add(Frame *f, String *s1, String *s2, String *s3)
     if (c.size >= mod.size && c.cmp(mod) >= 0) {
 	c.sub(mod);
 	if (c.cmp(mod) >= 0) {
-	    if (ticks(f, mod.size * (c.size - mod.size + 10))) {
+	    if (ticks(f, WORDS(mod.size) * (WORDS(c.size - mod.size) + 10))) {
 		AFREE(b.num);
 		AFREE(a.num);
 		AFREE(mod.num);
 		EC->error("Out of ticks");
 	    }
-	    Asi t(ALLOCA(Uint, (mod.size << 1) + 1), 0);
+	    Asi t(ALLOCA(Limb, (mod.size << 1) + 1), 0);
 	    c.div(c, mod, t);
 	    AFREE(t.num);
 	}
@@ -1422,17 +1435,17 @@ String *ASN::sub(Frame *f, String *s1, String *s2, String *s3)
     bool minusa, minusb, minusc;
     String *str;
 
-    Asi mod(ALLOCA(Uint, (s3->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s3->len) + 2), 0);
     if (mod.strtonum(s3) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 4), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 4), 0);
     minusa = a.strtonum(s1);
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 4), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 4), 0);
     minusb = b.strtonum(s2);
-    i_add_ticks(f, 4 + ((a.size + b.size + mod.size) >> 1));
+    i_add_ticks(f, 4 + (WORDS(a.size + b.size + mod.size) >> 1));
 
     if (minusa == minusb) {
 	if (a.size > b.size || (a.size == b.size && a.cmp(b) >= 0)) {
@@ -1463,13 +1476,13 @@ String *ASN::sub(Frame *f, String *s1, String *s2, String *s3)
     if (c.size >= mod.size && c.cmp(mod) >= 0) {
 	c.sub(mod);
 	if (c.cmp(mod) >= 0) {
-	    if (ticks(f, mod.size * (c.size - mod.size + 10))) {
+	    if (ticks(f, WORDS(mod.size) * (WORDS(c.size - mod.size) + 10))) {
 		AFREE(b.num);
 		AFREE(a.num);
 		AFREE(mod.num);
 		EC->error("Out of ticks");
 	    }
-	    Asi t(ALLOCA(Uint, (mod.size << 1) + 1), 0);
+	    Asi t(ALLOCA(Limb, (mod.size << 1) + 1), 0);
 	    c.div(c, mod, t);
 	    AFREE(t.num);
 	}
@@ -1489,11 +1502,11 @@ int ASN::cmp(Frame *f, String *s1, String *s2)
     bool minusa, minusb;
     int cmp;
 
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
     minusa = a.strtonum(s1);
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     minusb = b.strtonum(s2);
-    i_add_ticks(f, 4 + ((a.size + b.size) >> 1));
+    i_add_ticks(f, 4 + (WORDS(a.size + b.size) >> 1));
 
     if (minusa != minusb) {
 	if (minusa) {
@@ -1530,17 +1543,17 @@ String *ASN::mult(Frame *f, String *s1, String *s2, String *s3)
     bool minusa, minusb;
     String *str;
 
-    Asi mod(ALLOCA(Uint, (s3->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s3->len) + 2), 0);
     if (mod.strtonum(s3) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
     minusa = a.strtonum(s1);
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     minusb = b.strtonum(s2);
-    if (ticks(f, 4 + a.size * b.size)) {
+    if (ticks(f, 4 + WORDS(a.size) * WORDS(b.size))) {
 	AFREE(b.num);
 	AFREE(a.num);
 	AFREE(mod.num);
@@ -1548,13 +1561,13 @@ String *ASN::mult(Frame *f, String *s1, String *s2, String *s3)
     }
 
     size = a.size + b.size;
-    Asi c(ALLOCA(Uint, size + 1), size);
-    memset(c.num, '\0', c.size * sizeof(Uint));
-    Asi t(ALLOCA(Uint, (c.size << 1) + c.size), 0);
+    Asi c(ALLOCA(Limb, size + 1), size);
+    memset(c.num, '\0', c.size * sizeof(Limb));
+    Asi t(ALLOCA(Limb, (c.size << 1) + c.size), 0);
     c.mult(a, b, t);
 
     if (c.size >= mod.size && c.cmp(mod) >= 0) {
-	if (ticks(f, mod.size * (c.size - mod.size + 10))) {
+	if (ticks(f, WORDS(mod.size) * (WORDS(c.size - mod.size) + 10))) {
 	    AFREE(t.num);
 	    AFREE(c.num);
 	    AFREE(b.num);
@@ -1582,27 +1595,27 @@ String *ASN::div(Frame *f, String *s1, String *s2, String *s3)
     bool minusa, minusb;
     String *str;
 
-    Asi mod(ALLOCA(Uint, (s3->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s3->len) + 2), 0);
     if (mod.strtonum(s3) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     minusb = b.strtonum(s2);
     if (b.size == 1 && b.num[0] == 0) {
 	AFREE(b.num);
 	AFREE(mod.num);
 	EC->error("Division by zero");
     }
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
     minusa = a.strtonum(s1);
-    i_add_ticks(f, 4 + ((a.size + b.size) >> 1));
+    i_add_ticks(f, 4 + (WORDS(a.size + b.size) >> 1));
 
-    Asi c(ALLOCA(Uint, a.size + 2), 0);
-    Asi t(ALLOCA(Uint, (b.size + mod.size) << 1), 0); /* more than enough */
+    Asi c(ALLOCA(Limb, a.size + 2), 0);
+    Asi t(ALLOCA(Limb, (b.size + mod.size) << 1), 0); /* more than enough */
     if (a.size >= b.size && a.cmp(b) >= 0) {
-	if (ticks(f, b.size * (a.size - b.size + 10))) {
+	if (ticks(f, WORDS(b.size) * (WORDS(a.size - b.size) + 10))) {
 	    AFREE(t.num);
 	    AFREE(c.num);
 	    AFREE(a.num);
@@ -1612,7 +1625,7 @@ String *ASN::div(Frame *f, String *s1, String *s2, String *s3)
 	}
 	Asi d(c.div(a, b, t), a.size - b.size + 1);
 	if (d.size >= mod.size && d.cmp(mod) >= 0) {
-	    if (ticks(f, mod.size * (d.size - mod.size + 10))) {
+	    if (ticks(f, WORDS(mod.size) * (WORDS(d.size - mod.size) + 10))) {
 		AFREE(t.num);
 		AFREE(c.num);
 		AFREE(a.num);
@@ -1646,18 +1659,18 @@ String *ASN::mod(Frame *f, String *s1, String *s2)
     bool minusa;
     String *str;
 
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     if (b.strtonum(s2) || (b.size == 1 && b.num[0] == 0)) {
 	AFREE(b.num);
 	EC->error("Invalid modulus");
     }
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
     minusa = a.strtonum(s1);
 
-    Asi c(ALLOCA(Uint, a.size + 2), 0);
-    Asi t(ALLOCA(Uint, (b.size << 1) + 1), 0);
+    Asi c(ALLOCA(Limb, a.size + 2), 0);
+    Asi t(ALLOCA(Limb, (b.size << 1) + 1), 0);
     if (a.size >= b.size && a.cmp(b) > 0) {
-	if (ticks(f, b.size * (a.size - b.size + 10))) {
+	if (ticks(f, WORDS(b.size) * (WORDS(a.size - b.size) + 10))) {
 	    AFREE(t.num);
 	    AFREE(c.num);
 	    AFREE(a.num);
@@ -1666,7 +1679,7 @@ String *ASN::mod(Frame *f, String *s1, String *s2)
 	}
 	c.div(a, b, t);
     } else {
-	i_add_ticks(f, 4 + a.size + (b.size >> 1));
+	i_add_ticks(f, 4 + WORDS(a.size) + (WORDS(b.size) >> 1));
 	c.copy(a);
     }
     str = c.numtostr(minusa);
@@ -1687,19 +1700,19 @@ String *ASN::pow(Frame *f, String *s1, String *s2, String *s3)
     bool minusa, minusb;
     String *str;
 
-    Asi mod(ALLOCA(Uint, (s3->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s3->len) + 2), 0);
     if (mod.strtonum(s3) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    Asi a(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
     minusa = a.strtonum(s1);
-    Asi b(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi b(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     minusb = b.strtonum(s2);
-    ticks1 = mod.size * mod.size;
-    ticks2 = ticks1 * b.size;
-    if (ticks2 / b.size != ticks1) {
+    ticks1 = WORDS(mod.size) * WORDS(mod.size);
+    ticks2 = ticks1 * WORDS(b.size);
+    if (ticks2 / WORDS(b.size) != ticks1) {
 	AFREE(b.num);
 	AFREE(a.num);
 	AFREE(mod.num);
@@ -1713,11 +1726,11 @@ String *ASN::pow(Frame *f, String *s1, String *s2, String *s3)
 	EC->error("Out of ticks");
     }
 
-    Asi c(ALLOCA(Uint, mod.size), mod.size);
-    Asi t(ALLOCA(Uint, mod.size << 2), 0);
+    Asi c(ALLOCA(Limb, mod.size), mod.size);
+    Asi t(ALLOCA(Limb, mod.size << 2), 0);
     if (minusb) {
 	/* a ** -b = (a ** -1) ** b */
-	if (ticks(f, a.size * (mod.size + 10))) {
+	if (ticks(f, WORDS(a.size) * (WORDS(mod.size) + 10))) {
 	    AFREE(t.num);
 	    AFREE(c.num);
 	    AFREE(b.num);
@@ -1737,7 +1750,7 @@ String *ASN::pow(Frame *f, String *s1, String *s2, String *s3)
     } else {
 	c.power(a, b, mod, t);
     }
-    str = c.numtostr(minusa & (bool) b.num[0]);
+    str = c.numtostr(minusa & (bool) (b.num[0] & 1));
     AFREE(t.num);
     AFREE(c.num);
 
@@ -1760,37 +1773,37 @@ String *ASN::lshift(Frame *f, String *s1, Int shift, String *s2)
     if (shift < 0) {
 	EC->error("Negative left shift");
     }
-    Asi mod(ALLOCA(Uint, (s2->len >> 2) + 2), 0);
+    Asi mod(ALLOCA(Limb, LIMBS(s2->len) + 2), 0);
     if (mod.strtonum(s2) || (mod.size == 1 && mod.num[0] == 0)) {
 	AFREE(mod.num);
 	EC->error("Invalid modulus");
     }
 
-    size = (s1->len >> 2) + 2 + ((shift + 31) >> 5);
-    i_add_ticks(f, 4 + size + (mod.size >> 1));
+    size = LIMBS(s1->len) + 2 + ((shift + LIMB_MASK) >> LIMB_SHIFT);
+    i_add_ticks(f, 4 + WORDS(size) + (WORDS(mod.size) >> 1));
     if (size <= mod.size << 2) {
 	/*
 	 * perform actual left shift
 	 */
-	a = Asi(ALLOCA(Uint, size), 0);
-	t = Asi(ALLOCA(Uint, (mod.size << 1) + 1), 0);
+	a = Asi(ALLOCA(Limb, size), 0);
+	t = Asi(ALLOCA(Limb, (mod.size << 1) + 1), 0);
 	minusa = a.strtonum(s1);
 	if (shift != 0) {
-	    a.size += (shift + 31) >> 5;
+	    a.size += (shift + LIMB_MASK) >> LIMB_SHIFT;
 	    a.lshift(shift);
 	}
     } else {
 	/*
 	 * multiply with 2 ** shift
 	 */
-	size = (s1->len >> 2) + 4 + mod.size;
-	a = Asi(ALLOCA(Uint, size), 1);
+	size = LIMBS(s1->len) + 4 + mod.size;
+	a = Asi(ALLOCA(Limb, size), 1);
 	if (size < mod.size << 2) {
 	    size = mod.size << 2;
 	}
-	t = Asi(ALLOCA(Uint, size), 0);
-	Asi b(ALLOCA(Uint, mod.size), 1);
-	Asi c(ALLOCA(Uint, (s1->len >> 2) + 2), 0);
+	t = Asi(ALLOCA(Limb, size), 0);
+	Asi b(ALLOCA(Limb, mod.size), 1);
+	Asi c(ALLOCA(Limb, LIMBS(s1->len) + 2), 0);
 	minusa = c.strtonum(s1);
 	a.num[0] = 2;
 	b.num[0] = shift;
@@ -1801,7 +1814,7 @@ String *ASN::lshift(Frame *f, String *s1, Int shift, String *s2)
     }
 
     if (a.size >= mod.size && a.cmp(mod) >= 0) {
-	if (ticks(f, mod.size * (a.size - mod.size + 10))) {
+	if (ticks(f, WORDS(mod.size) * (WORDS(a.size - mod.size) + 10))) {
 	    AFREE(t.num);
 	    AFREE(a.num);
 	    AFREE(mod.num);
@@ -1827,10 +1840,10 @@ String *ASN::rshift(Frame *f, String *s, Int shift)
     if (shift < 0) {
 	EC->error("Negative right shift");
     }
-    Asi a(ALLOCA(Uint, (s->len >> 2) + 2), 0);
+    Asi a(ALLOCA(Limb, LIMBS(s->len) + 2), 0);
     minusa = a.strtonum(s);
-    i_add_ticks(f, 4 + a.size);
-    if (shift >> 5 >= a.size) {
+    i_add_ticks(f, 4 + WORDS(a.size));
+    if (shift >> LIMB_SHIFT >= a.size) {
 	a.num[0] = 0;
 	a.size = 1;
     } else if (shift != 0) {
@@ -71,42 +71,51 @@ extern "C" {
 static void *ipa_run(void *arg)
 {
     char buf[sizeof(In46Addr)];
+    char name[MAXHOSTNAMELEN];
     struct Pipes *inout;
-    struct hostent *host;
+    union {
+# ifdef INET6
+	struct sockaddr_in6 sin6;
+# endif
+	struct sockaddr_in sin;
+    } sa;
+    socklen_t salen;
     int len;
 
     inout = (Pipes *) arg;
 
     while (read(inout->in, buf, sizeof(In46Addr)) > 0) {
-	/* lookup host */
+	/* lookup host; getnameinfo() is safe to run in several threads */
+	memset(&sa, '\0', sizeof(sa));
 # ifdef INET6
 	if (((In46Addr *) &buf)->ipv6) {
-	    host = gethostbyaddr(buf, sizeof(struct in6_addr), AF_INET6);
-	    if (host == (struct hostent *) NULL) {
-		sleep(2);
-		host = gethostbyaddr(buf, sizeof(struct in6_addr), AF_INET6);
-	    }
+	    sa.sin6.sin6_family = AF_INET6;
+	    sa.sin6.sin6_addr = ((In46Addr *) &buf)->addr6;
+	    salen = sizeof(struct sockaddr_in6);
 	} else
 # endif
 	{
-	    host = gethostbyaddr(buf, sizeof(struct in_addr), AF_INET);
-	    if (host == (struct hostent *) NULL) {
-		sleep(2);
-		host = gethostbyaddr(buf, sizeof(struct in_addr), AF_INET);
+	    sa.sin.sin_family = AF_INET;
+	    sa.sin.sin_addr = ((In46Addr *) &buf)->addr;
+	    salen = sizeof(struct sockaddr_in);
+	}
+	if (getnameinfo((struct sockaddr *) &sa, salen, name, MAXHOSTNAMELEN,
+			(char *) NULL, 0, NI_NAMEREQD) != 0) {
+	    sleep(2);
+	    if (getnameinfo((struct sockaddr *) &sa, salen, name,
+			    MAXHOSTNAMELEN, (char *) NULL, 0, NI_NAMEREQD) != 0)
+	    {
+		name[0] = '\0';
 	    }
 	}
 
-	if (host != (struct hostent *) NULL) {
-	    char *name;
-
+	if (name[0] != '\0') {
 	    /* write host name */
-	    name = (char *) host->h_name;
 	    len = strlen(name);
 	    if (len >= MAXHOSTNAMELEN) {
 		len = MAXHOSTNAMELEN - 1;
 	    }
 	    (void) write(inout->out, name, len);
-	    name[0] = '\0';
 	} else {
 	    (void) write(inout->out, "", 1);	/* failure */
 	}
@@ -125,31 +134,45 @@ public:
 
     static bool init(int maxusers);
     static void finish();
+    static int fdset(fd_set *fds);
     static IpAddr *create(In46Addr *ipnum);
-    static void lookup();
+    static void lookup(fd_set *fds);
 
     In46Addr ipnum;			/* ip number */
     char name[MAXHOSTNAMELEN];		/* ip name */
 
 private:
+    void request();
+
     IpAddr *link;			/* next in hash table */
     IpAddr *prev;			/* previous in linked list */
     IpAddr *next;			/* next in linked list */
     Uint ref;				/* reference count */
+    Uint expire;			/* time when name must be refreshed */
+    bool query;				/* lookup queued or in progress */
 };
 
-# define NFREE		32
+# define NRESOLV	4		/* # name resolver threads */
+# define NFREE		128		/* # unreferenced names cached */
+# define POSTTL		3600		/* seconds to cache a name */
+# define NEGTTL		300		/* seconds to cache a failure */
+
+struct Resolver {
+    int in;				/* pipe from name resolver */
+    int out;				/* pipe to name resolver */
+    IpAddr *req;			/* request in progress */
+    bool busy;				/* name resolver busy */
+    pthread_t thread;			/* name lookup thread */
+};
 
-static int in = -1, out = -1;		/* pipe to/from name resolver */
+static Resolver resolv[NRESOLV];	/* name resolvers */
+static int nresolv;			/* # name resolvers running */
 static int addrtype;			/* network address family */
 static IpAddr **ipahtab;		/* ip address hash table */
 static unsigned int ipahtabsz;		/* hash table size */
 static IpAddr *qhead, *qtail;		/* request queue */
 static IpAddr *ffirst, *flast;		/* free list */
 static int nfree;			/* # in free list */
-static IpAddr *lastreq;			/* last request */
-static bool busy;			/* name resolver busy */
-static pthread_t lookup;		/* name lookup thread */
 
 
 /*
@@ -157,44 +180,60 @@ static pthread_t lookup;		/* name lookup thread */
  */
 bool IpAddr::init(int maxusers)
 {
-    if (in < 0) {
+    int i;
+
+    if (nresolv == 0) {
 	int fd[4];
-	static Pipes inout;
+	static Pipes inout[NRESOLV];
 
-	if (pipe(fd) < 0) {
-	    perror("pipe");
-	    return FALSE;
-	}
-	if (pipe(fd + 2) < 0) {
-	    perror("pipe");
-	    close(fd[0]);
-	    close(fd[1]);
-	    return FALSE;
+	for (i = 0; i < NRESOLV; i++) {
+	    if (pipe(fd) < 0) {
+		perror("pipe");
+		break;
+	    }
+	    if (pipe(fd + 2) < 0) {
+		perror("pipe");
+		close(fd[0]);
+		close(fd[1]);
+		break;
+	    }
+	    inout[i].in = fd[0];
+	    inout[i].out = fd[3];
+	    if (pthread_create(&resolv[i].thread, NULL, &ipa_run,
+			       &inout[i]) != 0) {
+		perror("pthread_create");
+		close(fd[0]);
+		close(fd[1]);
+		close(fd[2]);
+		close(fd[3]);
+		break;
+	    }
+	    resolv[i].in = fd[2];
+	    resolv[i].out = fd[1];
 	}
-	inout.in = fd[0];
-	inout.out = fd[3];
-	if (pthread_create(&::lookup, NULL, &ipa_run, &inout) < 0) {
-	    perror("pthread_create");
-	    close(fd[0]);
-	    close(fd[1]);
-	    close(fd[2]);
-	    close(fd[3]);
+	if (i == 0) {
 	    return FALSE;
 	}
-	in = fd[2];
-	out = fd[1];
-    } else if (busy) {
+	nresolv = i;
+    } else {
 	char buf[MAXHOSTNAMELEN];
 
-	/* discard ip name */
-	(void) read(in, buf, MAXHOSTNAMELEN);
+	for (i = 0; i < nresolv; i++) {
+	    if (resolv[i].busy) {
+		/* discard ip name */
+		(void) read(resolv[i].in, buf, MAXHOSTNAMELEN);
+	    }
+	}
     }
 
-    ipahtab = ALLOC(IpAddr*, ipahtabsz = maxusers);
+    for (i = 0; i < nresolv; i++) {
+	resolv[i].req = (IpAddr *) NULL;
+	resolv[i].busy = FALSE;
+    }
+    ipahtab = ALLOC(IpAddr*, ipahtabsz = maxusers + NFREE);
     memset(ipahtab, '\0', ipahtabsz * sizeof(IpAddr*));
-    qhead = qtail = ffirst = flast = lastreq = (IpAddr *) NULL;
+    qhead = qtail = ffirst = flast = (IpAddr *) NULL;
     nfree = 0;
-    busy = FALSE;
 
     return TRUE;
 }
@@ -204,8 +243,59 @@ bool IpAddr::init(int maxusers)
  */
 void IpAddr::finish()
 {
-    close(out);
-    close(in);
+    int i;
+
+    for (i = 0; i < nresolv; i++) {
+	close(resolv[i].out);
+	close(resolv[i].in);
+    }
+}
+
+/*
+ * add the name resolver pipes to a set of file descriptors, and return
+ * the highest one
+ */
+int IpAddr::fdset(fd_set *fds)
+{
+    int i, max;
+
+    max = 0;
+    for (i = 0; i < nresolv; i++) {
+	FD_SET(resolv[i].in, fds);
+	if (resolv[i].in > max) {
+	    max = resolv[i].in;
+	}
+    }
+    return max;
+}
+
+/*
+ * have the name of this ipaddr looked up by an idle resolver, or queue
+ * the request
+ */
+void IpAddr::request()
+{
+    int i;
+
+    query = TRUE;
+    for (i = 0; i < nresolv; i++) {
+	if (!resolv[i].busy) {
+	    /* send query to name resolver */
+	    (void) write(resolv[i].out, (char *) &ipnum, sizeof(In46Addr));
+	    resolv[i].req = this;
+	    resolv[i].busy = TRUE;
+	    return;
+	}
+    }
+
+    /* put in request queue */
+    prev = qtail;
+    if (qtail == (IpAddr *) NULL) {
+	qhead = this;
+    } else {
+	qtail->next = this;
+    }
+    qtail = this;
 }
 
 /*
@@ -256,23 +346,9 @@ IpAddr *IpAddr::create(In46Addr *ipnum)
 	    }
 	    ipa->ref++;
 
-	    if (ipa->name[0] == '\0' && ipa != lastreq &&
-		ipa->prev == (IpAddr *) NULL && ipa != qhead) {
-		if (!busy) {
-		    /* send query to name resolver */
-		    (void) write(out, (char *) ipnum, sizeof(In46Addr));
-		    lastreq = ipa;
-		    busy = TRUE;
-		} else {
-		    /* put in request queue */
-		    ipa->prev = qtail;
-		    if (qtail == (IpAddr *) NULL) {
-			qhead = ipa;
-		    } else {
-			qtail->next = ipa;
-		    }
-		    qtail = ipa;
-		}
+	    if (!ipa->query && ipa->expire <= P_time()) {
+		/* refresh: the old name, if any, remains until replaced */
+		ipa->request();
 	    }
 	    return ipa;
 	}
@@ -281,6 +357,7 @@ IpAddr *IpAddr::create(In46Addr *ipnum)
 
     if (nfree >= NFREE) {
 	IpAddr **h;
+	int i;
 
 	/*
 	 * use first ipaddr in free list
@@ -290,8 +367,12 @@ IpAddr *IpAddr::create(In46Addr *ipnum)
 	ffirst->prev = (IpAddr *) NULL;
 	--nfree;
 
-	if (ipa == lastreq) {
-	    lastreq = (IpAddr *) NULL;
+	if (ipa->query) {
+	    for (i = 0; i < nresolv; i++) {
+		if (resolv[i].req == ipa) {
+		    resolv[i].req = (IpAddr *) NULL;
+		}
+	    }
 	}
 
 	if (hash != &ipa->link) {
@@ -332,22 +413,8 @@ IpAddr *IpAddr::create(In46Addr *ipnum)
     ipa->ipnum = *ipnum;
     ipa->name[0] = '\0';
     ipa->prev = ipa->next = (IpAddr *) NULL;
-
-    if (!busy) {
-	/* send query to name resolver */
-	(void) write(out, (char *) ipnum, sizeof(In46Addr));
-	lastreq = ipa;
-	busy = TRUE;
-    } else {
-	/* put in request queue */
-	ipa->prev = qtail;
-	if (qtail == (IpAddr *) NULL) {
-	    qhead = ipa;
-	} else {
-	    qtail->next = ipa;
-	}
-	qtail = ipa;
-    }
+    ipa->expire = 0;
+    ipa->request();
 
     return ipa;
 }
@@ -370,6 +437,7 @@ void IpAddr::del()
 	    } else {
 		qtail = prev;
 	    }
+	    query = FALSE;
 	}
 
 	/* add to free list */
@@ -387,44 +455,58 @@ void IpAddr::del()
 }
 
 /*
- * lookup another ip name
+ * collect ip names from the resolvers that have answered, and hand them
+ * new queries
  */
-void IpAddr::lookup()
+void IpAddr::lookup(fd_set *fds)
 {
     IpAddr *ipa;
+    Resolver *r;
+    char buf[MAXHOSTNAMELEN];
+    int i, len;
 
-    if (lastreq != (IpAddr *) NULL) {
-	/* read ip name */
-	lastreq->name[read(in, lastreq->name, MAXHOSTNAMELEN)] = '\0';
-    } else {
-	char buf[MAXHOSTNAMELEN];
+    for (r = resolv, i = nresolv; i > 0; r++, --i) {
+	if (!FD_ISSET(r->in, fds)) {
+	    continue;
+	}
 
-	/* discard ip name */
-	(void) read(in, buf, MAXHOSTNAMELEN);
-    }
+	/* read ip name */
+	len = read(r->in, buf, MAXHOSTNAMELEN);
+	ipa = r->req;
+	if (ipa != (IpAddr *) NULL) {
+	    if (len > 0 && buf[0] != '\0') {
+		memcpy(ipa->name, buf, len);
+		ipa->name[len] = '\0';
+		ipa->expire = P_time() + POSTTL;
+	    } else {
+		ipa->name[0] = '\0';
+		ipa->expire = P_time() + NEGTTL;
+	    }
+	    ipa->query = FALSE;
+	}
 
-    /* if request queue not empty, write new query */
-    if (qhead != (IpAddr *) NULL) {
-	ipa = qhead;
-	(void) write(out, (char *) &ipa->ipnum, sizeof(In46Addr));
-	qhead = ipa->next;
-	if (qhead == (IpAddr *) NULL) {
-	    qtail = (IpAddr *) NULL;
+	/* if request queue not empty, write new query */
+	if (qhead != (IpAddr *) NULL) {
+	    ipa = qhead;
+	    (void) write(r->out, (char *) &ipa->ipnum, sizeof(In46Addr));
+	    qhead = ipa->next;
+	    if (qhead == (IpAddr *) NULL) {
+		qtail = (IpAddr *) NULL;
+	    } else {
+		qhead->prev = (IpAddr *) NULL;
+	    }
+	    ipa->prev = ipa->next = (IpAddr *) NULL;
+	    r->req = ipa;
 	} else {
-	    qhead->prev = (IpAddr *) NULL;
+	    r->req = (IpAddr *) NULL;
+	    r->busy = FALSE;
 	}
-	ipa->prev = ipa->next = (IpAddr *) NULL;
-	lastreq = ipa;
-	busy = TRUE;
-    } else {
-	lastreq = (IpAddr *) NULL;
-	busy = FALSE;
     }
 }
 
 class XConnection : public Hashtab::Entry, public Connection, public Allocated {
 public:
-    XConnection() : fd(-1) { }
+    XConnection() : fd(-1) { user = (User *) NULL; }
 
     virtual bool attach();
     virtual bool udp(char *challenge, unsigned int len);
@@ -462,6 +544,7 @@ public:
     IpAddr *addr;			/* internet address of connection */
     unsigned short port;		/* UDP port of connection */
     short at;				/* port connection was accepted at */
+    XConnection *cnext;			/* next in closed list */
 };
 
 struct PortDesc {
@@ -767,6 +850,8 @@ static fd_set readfds;			/* file descriptor read bitmap */
 static fd_set writefds;			/* file descriptor write map */
 static int maxfd;			/* largest fd opened yet */
 static int closed;			/* #fds closed in write */
+static XConnection **fdconn;		/* connections by file descriptor */
+static XConnection *clist;		/* list of closed connections */
 
 # ifdef INET6
 /*
@@ -887,12 +972,14 @@ bool Connection::init(int maxusers, char **thosts, char **bhosts, char **dhosts,
 
     nusers = 0;
 
-    maxfd = 0;
     FD_ZERO(&infds);
     FD_ZERO(&outfds);
     FD_ZERO(&waitfds);
-    FD_SET(in, &infds);
+    maxfd = IpAddr::fdset(&infds);
     closed = 0;
+    fdconn = ALLOC(XConnection*, FD_SETSIZE);
+    memset(fdconn, '\0', FD_SETSIZE * sizeof(XConnection*));
+    clist = (XConnection *) NULL;
 
     (void) pipe(fds);
     inpkts = fds[0];
@@ -1203,7 +1290,7 @@ void Connection::listen()
 
     for (n = 0; n < ntdescs; n++) {
 	if (tdescs[n].in6 >= 0) {
-	    if (::listen(tdescs[n].in6, 64) < 0) {
+	    if (::listen(tdescs[n].in6, SOMAXCONN) < 0) {
 		perror("listen");
 	    } else if (fcntl(tdescs[n].in6, F_SETFL, FNDELAY) < 0) {
 		perror("fcntl");
@@ -1215,7 +1302,7 @@ void Connection::listen()
     }
     for (n = 0; n < ntdescs; n++) {
 	if (tdescs[n].in4 >= 0) {
-	    if (::listen(tdescs[n].in4, 64) < 0) {
+	    if (::listen(tdescs[n].in4, SOMAXCONN) < 0) {
 # ifdef INET6
 		close(tdescs[n].in4);
 		FD_CLR(tdescs[n].in4, &infds);
@@ -1234,7 +1321,7 @@ void Connection::listen()
     }
     for (n = 0; n < nbdescs; n++) {
 	if (bdescs[n].in6 >= 0) {
-	    if (::listen(bdescs[n].in6, 64) < 0) {
+	    if (::listen(bdescs[n].in6, SOMAXCONN) < 0) {
 		perror("listen");
 	    } else if (fcntl(bdescs[n].in6, F_SETFL, FNDELAY) < 0) {
 		perror("fcntl");
@@ -1246,7 +1333,7 @@ void Connection::listen()
     }
     for (n = 0; n < nbdescs; n++) {
 	if (bdescs[n].in4 >= 0) {
-	    if (::listen(bdescs[n].in4, 64) < 0) {
+	    if (::listen(bdescs[n].in4, SOMAXCONN) < 0) {
 # ifdef INET6
 		close(bdescs[n].in4);
 		FD_CLR(bdescs[n].in4, &infds);
@@ -1281,12 +1368,18 @@ XConnection *XConnection::create6(int portfd, int port)
 	return (XConnection *) NULL;
     }
     len = sizeof(sin6);
+# ifdef SOCK_NONBLOCK
+    fd = accept4(portfd, (struct sockaddr *) &sin6, &len, SOCK_NONBLOCK);
+# else
     fd = accept(portfd, (struct sockaddr *) &sin6, &len);
+# endif
     if (fd < 0) {
 	FD_CLR(portfd, &readfds);
 	return (XConnection *) NULL;
     }
+# ifndef SOCK_NONBLOCK
     fcntl(fd, F_SETFL, FNDELAY);
+# endif
 
     conn = (XConnection *) flist;
     flist = conn->next;
@@ -1303,6 +1396,7 @@ XConnection *XConnection::create6(int portfd, int port)
     }
     conn->addr = IpAddr::create(&addr);
     conn->at = port;
+    fdconn[fd] = conn;
     FD_SET(fd, &infds);
     FD_SET(fd, &outfds);
     FD_CLR(fd, &readfds);
@@ -1330,12 +1424,18 @@ XConnection *XConnection::create(int portfd, int port)
 	return (XConnection *) NULL;
     }
     len = sizeof(sin);
+# ifdef SOCK_NONBLOCK
+    fd = accept4(portfd, (struct sockaddr *) &sin, &len, SOCK_NONBLOCK);
+# else
     fd = accept(portfd, (struct sockaddr *) &sin, &len);
+# endif
     if (fd < 0) {
 	FD_CLR(portfd, &readfds);
 	return (XConnection *) NULL;
     }
+# ifndef SOCK_NONBLOCK
     fcntl(fd, F_SETFL, FNDELAY);
+# endif
 
     conn = (XConnection *) flist;
     flist = conn->next;
@@ -1346,6 +1446,7 @@ XConnection *XConnection::create(int portfd, int port)
     addr.ipv6 = FALSE;
     conn->addr = IpAddr::create(&addr);
     conn->at = port;
+    fdconn[fd] = conn;
     FD_SET(fd, &infds);
     FD_SET(fd, &outfds);
     FD_CLR(fd, &readfds);
@@ -1532,14 +1633,19 @@ void XConnection::del()
 {
     Hashtab::Entry **hash;
 
+    XConnection **c;
+
     if (fd >= 0) {
 	shutdown(fd, SHUT_WR);
 	close(fd);
 	FD_CLR(fd, &infds);
 	FD_CLR(fd, &outfds);
 	FD_CLR(fd, &waitfds);
+	fdconn[fd] = (XConnection *) NULL;
 	fd = -1;
     } else if (fd == -1) {
+	for (c = &clist; *c != this; c = &(*c)->cnext) ;
+	*c = cnext;
 	--closed;
     }
     if (udpbuf != (char *) NULL) {
@@ -1652,12 +1758,33 @@ int Connection::select(Uint t, unsigned int mtime)
     ::select(maxfd + 1, (fd_set *) NULL, &writefds, (fd_set *) NULL, &timeout);
 
     /* handle ip name lookup */
-    if (FD_ISSET(in, &readfds)) {
-	IpAddr::lookup();
-    }
+    IpAddr::lookup(&readfds);
     return retval;
 }
 
+/*
+ * collect the connections with activity after select()
+ */
+int Connection::ready(Connection **list)
+{
+    XConnection *conn;
+    int fd, n;
+
+    n = 0;
+    for (fd = 0; fd <= maxfd; fd++) {
+	if ((FD_ISSET(fd, &readfds) ||
+	     (FD_ISSET(fd, &waitfds) && FD_ISSET(fd, &writefds))) &&
+	    (conn=fdconn[fd]) != (XConnection *) NULL) {
+	    list[n++] = conn;
+	}
+    }
+    for (conn = clist; conn != (XConnection *) NULL; conn = conn->cnext) {
+	list[n++] = conn;
+    }
+
+    return n;
+}
+
 /*
  * check if UDP challenge met
  */
@@ -1685,7 +1812,10 @@ int XConnection::read(char *buf, unsigned int len)
 	FD_CLR(fd, &infds);
 	FD_CLR(fd, &outfds);
 	FD_CLR(fd, &waitfds);
+	fdconn[fd] = (XConnection *) NULL;
 	fd = -1;
+	cnext = clist;
+	clist = this;
 	closed++;
     }
     return (size == 0) ? -1 : size;
@@ -1743,7 +1873,10 @@ int XConnection::write(char *buf, unsigned int len)
 	close(fd);
 	FD_CLR(fd, &infds);
 	FD_CLR(fd, &outfds);
+	fdconn[fd] = (XConnection *) NULL;
 	fd = -1;
+	cnext = clist;
+	clist = this;
 	closed++;
     } else if (size != len) {
 	/* waiting for wrdone */
@@ -1949,6 +2082,7 @@ Connection *Connection::connect(void *addr, int len)
     conn->udpbuf = (char *) NULL;
     conn->addr = (IpAddr *) NULL;
     conn->at = -1;
+    fdconn[sock] = conn;
     FD_SET(sock, &infds);
     FD_SET(sock, &outfds);
     FD_CLR(sock, &readfds);
@@ -2220,6 +2354,7 @@ Connection *Connection::import(int fd, char *addr, unsigned short port,
     conn->at = -1;
 
     if (fd >= 0) {
+	fdconn[fd] = conn;
 	FD_SET(fd, &infds);
 	FD_SET(fd, &outfds);
 	if (flags & CONN_READF) {
@@ -2273,6 +2408,8 @@ Connection *Connection::import(int fd, char *addr, unsigned short port,
 	    (void) ::write(outpkts, conn->udpbuf, npkts);
 	}
     } else {
+	conn->cnext = clist;
+	clist = conn;
 	closed++;
     }
 
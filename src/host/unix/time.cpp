@@ -41,6 +41,17 @@ Uint P_mtime(unsigned short *milli)
     return (Uint) time.tv_sec;
 }
 
+/*
+ * return a monotonic time in microseconds
+ */
+Uuint P_utime()
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (Uuint) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
 /*
  * convert the given time to a string
  */
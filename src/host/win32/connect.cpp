@@ -353,7 +353,7 @@ void IpAddr::lookup()
 
 class XConnection : public Hashtab::Entry, public Connection, public Allocated {
 public:
-    XConnection() : fd(INVALID_SOCKET) { }
+    XConnection() : fd(INVALID_SOCKET) { user = (User *) NULL; }
 
     virtual bool attach();
     virtual bool udp(char *challenge, unsigned int len);
@@ -388,6 +388,7 @@ public:
     IpAddr *addr;			/* internet address of connection */
     unsigned short port;		/* UDP port of connection */
     short at;				/* port connection was accepted at */
+    XConnection *cnext;			/* next in closed list */
 };
 
 struct PortDesc {
@@ -665,6 +666,7 @@ static fd_set waitfds;			/* file descriptor wait-write bitmap */
 static fd_set readfds;			/* file descriptor read bitmap */
 static fd_set writefds;			/* file descriptor write map */
 static int closed;			/* #fds closed in write */
+static XConnection *clist;		/* list of closed connections */
 static SOCKET self;			/* socket to self */
 static bool self6;			/* self socket IPv6? */
 static SOCKET cintr;			/* interrupt socket */
@@ -794,6 +796,7 @@ bool Connection::init(int maxusers, char **thosts, char **bhosts, char **dhosts,
     FD_ZERO(&outfds);
     FD_ZERO(&waitfds);
     closed = 0;
+    clist = (XConnection *) NULL;
 
     ntdescs = ntports;
     if (ntports != 0) {
@@ -1401,6 +1404,7 @@ bool XConnection::udp(char *challenge, unsigned int len)
 void XConnection::del()
 {
     Hashtab::Entry **hash;
+    XConnection **c;
 
     if (fd != INVALID_SOCKET) {
 	shutdown(fd, SD_SEND);
@@ -1410,6 +1414,8 @@ void XConnection::del()
 	FD_CLR(fd, &waitfds);
 	fd = INVALID_SOCKET;
     } else if (!udpFlag) {
+	for (c = &clist; *c != this; c = &(*c)->cnext) ;
+	*c = cnext;
 	--closed;
     }
     if (udpbuf != (char *) NULL) {
@@ -1531,6 +1537,34 @@ int Connection::select(Uint t, unsigned int mtime)
     return retval;
 }
 
+/*
+ * collect the connections with activity after select()
+ */
+int Connection::ready(Connection **list)
+{
+    XConnection **c, *conn;
+    int i, n;
+
+    /*
+     * a Winsock fd_set is not indexed by descriptor, so check the
+     * connection table against the (short) result sets
+     */
+    n = 0;
+    for (c = connections, i = nusers; i > 0; c++, --i) {
+	conn = *c;
+	if (conn->fd != INVALID_SOCKET &&
+	    (FD_ISSET(conn->fd, &readfds) ||
+	     (FD_ISSET(conn->fd, &waitfds) && FD_ISSET(conn->fd, &writefds)))) {
+	    list[n++] = conn;
+	}
+    }
+    for (conn = clist; conn != (XConnection *) NULL; conn = conn->cnext) {
+	list[n++] = conn;
+    }
+
+    return n;
+}
+
 /*
  * check if UDP challenge met
  */
@@ -1559,6 +1593,8 @@ int XConnection::read(char *buf, unsigned int len)
 	FD_CLR(fd, &outfds);
 	FD_CLR(fd, &waitfds);
 	fd = INVALID_SOCKET;
+	cnext = clist;
+	clist = this;
 	closed++;
     }
     return (size == 0 || size == SOCKET_ERROR) ? -1 : size;
@@ -1618,6 +1654,8 @@ int XConnection::write(char *buf, unsigned int len)
 	FD_CLR(fd, &infds);
 	FD_CLR(fd, &outfds);
 	fd = INVALID_SOCKET;
+	cnext = clist;
+	clist = this;
 	closed++;
     } else if ((unsigned int) size != len) {
 	/* waiting for wrdone */
@@ -54,6 +54,22 @@ Uint P_mtime(unsigned short *milli)
     return (Uint) (time / 10000000);
 }
 
+/*
+ * return a monotonic time in microseconds
+ */
+Uuint P_utime()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0) {
+	QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&count);
+    return (Uuint) (count.QuadPart / freq.QuadPart * 1000000 +
+		    count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+}
+
 /*
  * return time as string
  */
@@ -27,6 +27,8 @@
 # include "interpret.h"
 # include "ext.h"
 # include "table.h"
+# include "hash.h"
+# include "metrics.h"
 
 # ifdef DEBUG
 # undef EXTRA_STACK
@@ -144,6 +146,27 @@ void Frame::pushValue(Value *v)
     }
 }
 
+/*
+ * test the truth of a value without pushing it, treating destructed
+ * objects as nil
+ */
+static bool truthValue(Value *v)
+{
+    Value *o;
+
+    switch (v->type) {
+    case T_OBJECT:
+	return !DESTRUCTED(v);
+
+    case T_LWOBJECT:
+	o = Dataspace::elts(v->array);
+	return (o->type != T_OBJECT || !DESTRUCTED(o));
+
+    default:
+	return VAL_TRUE(v);
+    }
+}
+
 /*
  * pop a number of values (can be lvalues) from the stack
  */
@@ -448,8 +471,7 @@ char *Frame::className(Uint sclass)
 int Frame::instanceOf(unsigned int oindex, char *prog, Uint hash)
 {
     char *h;
-    unsigned short i;
-    Inherit *inh;
+    int i;
     Object *obj;
     Control *ctrl;
 
@@ -466,17 +488,14 @@ int Frame::instanceOf(unsigned int oindex, char *prog, Uint hash)
 	return (ctrl->inherits[UCHAR(*h)].priv) ? -1 : 1;	/* found it */
     }
 
-    /* next, search for it the hard way */
-    for (i = ctrl->ninherits, inh = ctrl->inherits + i; i != 0; ) {
-	--i;
-	--inh;
-	if (strcmp(prog, OBJR(inh->oindex)->name) == 0) {
-	    /* found it; update hashtable */
-	    *h = i;
-	    return (ctrl->inherits[i].priv) ? -1 : 1;
-	}
+    /* next, look it up in the sorted inherit table */
+    i = ctrl->findInherit(prog, Hashtab::hashstr(prog, OBJHASHSZ));
+    if (i < 0) {
+	return FALSE;
     }
-    return FALSE;
+    /* found it; update hashtable */
+    *h = i;
+    return (ctrl->inherits[i].priv) ? -1 : 1;
 }
 
 /*
@@ -583,6 +602,34 @@ void Frame::storeLocal(int local, Value *val)
     data->assignVar(fp - local, val);
 }
 
+/*
+ * Append a string to a local variable in place.  This can be done if the
+ * next instruction stores the sum in the local variable that the left
+ * operand was fetched from, and there are no references to the string
+ * other than the local variable and the operand itself.
+ */
+bool Frame::storeAppend(char *pc)
+{
+    Value *var;
+    String *str;
+
+    if ((*pc & I_INSTR_MASK & ~I_POP_BIT) != I_STORE_LOCAL ||
+	sp[1].type != T_STRING || sp->type != T_STRING) {
+	return FALSE;
+    }
+    var = (SCHAR(pc[1]) >= 0) ? argp + SCHAR(pc[1]) : fp + SCHAR(pc[1]);
+    str = sp[1].string;
+    if (var->type != T_STRING || var->string != str || str->refCount != 2) {
+	return FALSE;
+    }
+
+    i_add_ticks(this, 2);
+    str = str->append(sp->string);
+    (sp++)->string->del();
+    sp->string = var->string = str;
+    return TRUE;
+}
+
 /*
  * assign a value to a global variable
  */
@@ -1637,6 +1684,45 @@ unsigned short Frame::switchStr(char *pc)
     return dflt;
 }
 
+/*
+ * handle a string switch with a perfect hash table: one hash, one compare
+ */
+unsigned short Frame::switchStrHash(char *pc)
+{
+    unsigned short h, l, u, u2, dflt;
+    int rbits, mbits;
+    Uint hash;
+    char *p;
+
+    FETCH2U(pc, h);
+    FETCH2U(pc, dflt);
+    if (FETCH1U(pc) == 0) {
+	FETCH2U(pc, l);
+	if (VAL_NIL(sp)) {
+	    return l;
+	}
+	--h;
+    }
+    if (sp->type != T_STRING) {
+	return dflt;
+    }
+
+    p = pc + 5 * (h - 1);
+    rbits = FETCH1U(p);
+    mbits = FETCH1U(p);
+    hash = Hashtab::hashkey(sp->string->text, sp->string->len);
+    u = UCHAR(p[hash & ((1 << rbits) - 1)]);
+    p += (1 << rbits) + 2 * SWITCH_SLOT(hash, u, mbits);
+    if (FETCH2U(p, u) != 0) {
+	p = pc + 5 * (u - 1);
+	u = FETCH1U(p);
+	if (sp->string->cmp(p_ctrl->strconst(u, FETCH2U(p, u2))) == 0) {
+	    return FETCH2U(p, l);
+	}
+    }
+    return dflt;
+}
+
 /*
  * call kernel function
  */
@@ -1678,6 +1764,271 @@ void Frame::vfunc(int n, int nargs)
     funcall((Object *) NULL, (Array *) NULL, UCHAR(p[0]), UCHAR(p[1]), nargs);
 }
 
+# ifdef IPAIRS
+static Uint ipairs[I_INSTR_MASK + 1][I_INSTR_MASK + 1];	/* histogram */
+static int ilast;			/* previous instruction */
+
+/*
+ * show the most frequently executed instruction pairs
+ */
+void Frame::pairs()
+{
+    int n, i, j, mi, mj;
+
+    for (n = 0; n < 32; n++) {
+	mi = mj = 0;
+	for (i = 0; i <= I_INSTR_MASK; i++) {
+	    for (j = 0; j <= I_INSTR_MASK; j++) {
+		if (ipairs[i][j] > ipairs[mi][mj]) {
+		    mi = i;
+		    mj = j;
+		}
+	    }
+	}
+	if (ipairs[mi][mj] == 0) {
+	    break;
+	}
+	EC->message("%02x %02x %10lu\012", mi, mj,	/* LF */
+		    (unsigned long) ipairs[mi][mj]);
+	ipairs[mi][mj] = 0;
+    }
+}
+# endif
+
+/*
+ * perform a typed int or float operator inline
+ */
+void Frame::operate(int kf)
+{
+    Float f1, f2;
+
+    switch (kf) {
+    case KF_ADD_INT:
+	sp[1].number += sp->number;
+	sp++;
+	break;
+
+    case KF_ADD1_INT:
+	sp->number++;
+	break;
+
+    case KF_AND_INT:
+	sp[1].number &= sp->number;
+	sp++;
+	break;
+
+    case KF_DIV_INT:
+	sp[1].number = div(sp[1].number, sp->number);
+	sp++;
+	break;
+
+    case KF_EQ_INT:
+	sp[1].number = (sp[1].number == sp->number);
+	sp++;
+	break;
+
+    case KF_GE_INT:
+	sp[1].number = (sp[1].number >= sp->number);
+	sp++;
+	break;
+
+    case KF_GT_INT:
+	sp[1].number = (sp[1].number > sp->number);
+	sp++;
+	break;
+
+    case KF_LE_INT:
+	sp[1].number = (sp[1].number <= sp->number);
+	sp++;
+	break;
+
+    case KF_LSHIFT_INT:
+	sp[1].number = lshift(sp[1].number, sp->number);
+	sp++;
+	break;
+
+    case KF_LT_INT:
+	sp[1].number = (sp[1].number < sp->number);
+	sp++;
+	break;
+
+    case KF_MOD_INT:
+	sp[1].number = mod(sp[1].number, sp->number);
+	sp++;
+	break;
+
+    case KF_MULT_INT:
+	sp[1].number *= sp->number;
+	sp++;
+	break;
+
+    case KF_NE_INT:
+	sp[1].number = (sp[1].number != sp->number);
+	sp++;
+	break;
+
+    case KF_NEG_INT:
+	sp->number = ~sp->number;
+	break;
+
+    case KF_NOT_INT:
+	sp->number = !sp->number;
+	break;
+
+    case KF_OR_INT:
+	sp[1].number |= sp->number;
+	sp++;
+	break;
+
+    case KF_RSHIFT_INT:
+	sp[1].number = rshift(sp[1].number, sp->number);
+	sp++;
+	break;
+
+    case KF_SUB_INT:
+	sp[1].number -= sp->number;
+	sp++;
+	break;
+
+    case KF_SUB1_INT:
+	sp->number--;
+	break;
+
+    case KF_TST_INT:
+	sp->number = (sp->number != 0);
+	break;
+
+    case KF_UMIN_INT:
+	sp->number = -sp->number;
+	break;
+
+    case KF_XOR_INT:
+	sp[1].number ^= sp->number;
+	sp++;
+	break;
+
+    case KF_ADD_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	f1.add(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_ADD1_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f1);
+	f2.initOne();
+	f1.add(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_DIV_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	f1.div(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_EQ_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) == 0));
+	break;
+
+    case KF_GE_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) >= 0));
+	break;
+
+    case KF_GT_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) > 0));
+	break;
+
+    case KF_LE_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) <= 0));
+	break;
+
+    case KF_LT_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) < 0));
+	break;
+
+    case KF_MULT_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	f1.mult(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_NE_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	PUT_INTVAL(sp, (f1.cmp(f2) != 0));
+	break;
+
+    case KF_NOT_FLT:
+	PUT_INTVAL(sp, VFLT_ISZERO(sp));
+	break;
+
+    case KF_SUB_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f2);
+	sp++;
+	GET_FLT(sp, f1);
+	f1.sub(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_SUB1_FLT:
+	i_add_ticks(this, 1);
+	GET_FLT(sp, f1);
+	f2.initOne();
+	f1.sub(f2);
+	PUT_FLT(sp, f1);
+	break;
+
+    case KF_TST_FLT:
+	PUT_INTVAL(sp, !VFLT_ISZERO(sp));
+	break;
+
+    case KF_UMIN_FLT:
+	i_add_ticks(this, 1);
+	if (!VFLT_ISZERO(sp)) {
+	    GET_FLT(sp, f1);
+	    f1.negate();
+	    PUT_FLT(sp, f1);
+	}
+	break;
+
+    default:
+	EC->fatal("illegal operator %d", kf);
+    }
+}
+
 /*
  * Main interpreter function. Interpret stack machine code.
  */
@@ -1689,7 +2040,7 @@ void Frame::interpret(char *pc)
     KFun *kf;
     int size, instance;
     bool atomic;
-    Value val;
+    Value *v, val, ival;
 
     size = 0;
     l = 0;
@@ -1702,6 +2053,10 @@ void Frame::interpret(char *pc)
 # endif
 	instr = FETCH1U(pc);
 	this->pc = pc;
+# ifdef IPAIRS
+	ipairs[ilast][instr & I_INSTR_MASK]++;
+	ilast = instr & I_INSTR_MASK;
+# endif
 
 	switch (instr & I_INSTR_MASK) {
 	case I_PUSH_INT1:
@@ -1862,6 +2217,49 @@ void Frame::interpret(char *pc)
 	    storeIndexIndex(sp);
 	    break;
 
+	case I_OPERATOR:
+	case I_OPERATOR | I_POP_BIT:
+	    u = FETCH1U(pc);
+	    switch (u) {
+	    case I_OP_LOCAL_INDEX:
+		u = FETCH1S(pc);
+		v = ((short) u < 0) ? fp + (short) u : argp + u;
+		PUT_INTVAL(&ival, FETCH1S(pc));
+		index(v, &ival, &val, TRUE);
+		*--sp = val;
+		break;
+
+	    case I_OP_LOCAL | I_OP_JUMP:
+	    case I_OP_NOT_LOCAL | I_OP_JUMP:
+		u2 = FETCH1S(pc);
+		v = ((short) u2 < 0) ? fp + (short) u2 : argp + u2;
+		p = prog + FETCH2U(pc, u2);
+		if (truthValue(v) == (u == (I_OP_NOT_LOCAL | I_OP_JUMP))) {
+		    if (p < pc) {
+			loop_ticks(this);
+		    }
+		    pc = p;
+		}
+		continue;
+
+	    default:
+		if (u & I_OP_JUMP) {
+		    /* compare and jump */
+		    p = prog + FETCH2U(pc, u2);
+		    operate(u & ~I_OP_JUMP);
+		    if ((sp++)->number == 0) {
+			if (p < pc) {
+			    loop_ticks(this);
+			}
+			pc = p;
+		    }
+		    continue;
+		}
+		operate(u);
+		break;
+	    }
+	    break;
+
 	case I_JUMP_ZERO:
 	    p = prog + FETCH2U(pc, u);
 	    if (!VAL_TRUE(sp)) {
@@ -1905,6 +2303,10 @@ void Frame::interpret(char *pc)
 	    case SWITCH_STRING:
 		p = prog + switchStr(pc);
 		break;
+
+	    case SWITCH_STRHASH:
+		p = prog + switchStrHash(pc);
+		break;
 	    }
 	    if (p < pc) {
 		loop_ticks(this);
@@ -1916,6 +2318,9 @@ void Frame::interpret(char *pc)
 	case I_CALL_KFUNC:
 	case I_CALL_KFUNC | I_POP_BIT:
 	    u = FETCH1U(pc);
+	    if (u == KF_ADD && !(instr & I_POP_BIT) && storeAppend(pc)) {
+		break;
+	    }
 	    kf = &KFUN(u);
 	    if (PROTO_VARGS(kf->proto) != 0) {
 		/* variable # of arguments */
@@ -2293,6 +2698,11 @@ bool Frame::call(Object *obj, Array *lwobj, const char *func, unsigned int len,
     FuncDef *fdef;
     Control *ctrl;
 
+    if (oindex == OBJ_NONE && obj != (Object *) NULL) {
+	/* called from the top level */
+	Metrics::call(obj, func, len);
+    }
+
     if (lwobj != (Array *) NULL) {
 	uindex oindex;
 	Float flt;
@@ -2436,6 +2846,19 @@ unsigned short Frame::line()
 	    }
 	    break;
 
+	case I_OPERATOR:
+	case I_OPERATOR | I_POP_BIT:
+	    u = FETCH1U(pc);
+	    if ((u & ~I_OP_JUMP) >= I_OP_LOCAL_INDEX) {
+		pc++;
+	    }
+	    if (u == I_OP_LOCAL_INDEX) {
+		pc++;
+	    } else if (u & I_OP_JUMP) {
+		pc += 2;
+	    }
+	    break;
+
 	case I_PUSH_INT1:
 	case I_PUSH_STRING:
 	case I_PUSH_LOCAL:
@@ -2537,6 +2960,18 @@ unsigned short Frame::line()
 		}
 		pc += (u - 1) * 5;
 		break;
+
+	    case 3:
+		FETCH2U(pc, u);
+		pc += 2;
+		if (FETCH1U(pc) == 0) {
+		    pc += 2;
+		    --u;
+		}
+		pc += (u - 1) * 5;
+		sz = FETCH1U(pc);
+		pc += (1 << sz) + 2 * (1 << FETCH1U(pc));
+		break;
 	    }
 	    break;
 	}
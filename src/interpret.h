@@ -22,6 +22,7 @@
 # define I_PUSH_INT1		0x00	/* 1 signed */
 # define I_PUSH_INT2		0x20	/* 2 signed */
 # define I_PUSH_INT4		0x01	/* 4 signed */
+# define I_OPERATOR		0x02	/* 1 unsigned (+ 2 unsigned) */
 # define I_PUSH_INT8		0x21	/* reserved */
 # define I_PUSH_FLOAT6		0x03	/* 6 unsigned */
 # define I_PUSH_FLOAT12		0x23	/* reserved */
@@ -61,12 +62,19 @@
 # define I_RLIMITS		0x1f
 # define I_RETURN		0x3f
 
+# define I_OP_JUMP		0x80	/* operator: compare and jump if false */
+
+/* superinstructions, above the builtin kfuns in the I_OPERATOR operand */
+# define I_OP_LOCAL_INDEX	0x70	/* 1 signed, 1 signed */
+# define I_OP_LOCAL		0x71	/* 1 signed, 2 unsigned (+ I_OP_JUMP) */
+# define I_OP_NOT_LOCAL		0x72	/* 1 signed, 2 unsigned (+ I_OP_JUMP) */
+
 # define I_LINE_MASK		0xc0	/* line add bits */
 # define I_POP_BIT		0x20	/* pop 1 after instruction */
 # define I_LINE_SHIFT		6
 
 # define VERSION_VM_MAJOR	2
-# define VERSION_VM_MINOR	1
+# define VERSION_VM_MINOR	4
 
 
 # define FETCH1S(pc)	SCHAR(*(pc)++)
@@ -159,6 +167,11 @@
 # define SWITCH_INT	0
 # define SWITCH_RANGE	1
 # define SWITCH_STRING	2
+# define SWITCH_STRHASH	3
+
+# define SWITCH_HASHMIN	16	/* min # of strings for a hashed switch */
+# define SWITCH_SLOT(h, d, bits)	\
+			((((h) ^ (d)) * (Uint) 0x9e3779b1L) >> (32 - (bits)))
 
 
 struct RLInfo {
@@ -222,6 +235,9 @@ public:
     static Int rshift(Int num, Int shift);
     static void runtimeError(Frame *f, Int depth);
     static void clear();
+# ifdef IPAIRS
+    static void pairs();
+# endif
 
     Frame *prev;		/* previous stack frame */
     uindex oindex;		/* current object index */
@@ -252,6 +268,8 @@ private:
     int instanceOf(unsigned int oindex, Uint sclass);
     bool storeIndex(Value *var, Value *aval, Value *ival, Value *val);
     void stores(int skip, int assign);
+    bool storeAppend(char *pc);
+    void operate(int kf);
     void checkRlimits();
     void newRlimits(Int depth, Int t);
     void typecheck(Frame *f, const char *name, const char *ftype, char *proto,
@@ -259,6 +277,7 @@ private:
     unsigned short switchInt(char *pc);
     unsigned short switchRange(char *pc);
     unsigned short switchStr(char *pc);
+    unsigned short switchStrHash(char *pc);
     void interpret(char *pc);
     unsigned short line();
     Array *funcTrace(Dataspace *data);
@@ -22,6 +22,7 @@
 # include "kfun.h"
 # include "parse.h"
 # include "asn.h"
+# include "hash.h"
 # endif
 
 # ifdef FUNCDEF
@@ -369,54 +370,181 @@ char pt_sscanf[] = { C_STATIC | C_ELLIPSIS, 2, 1, 0, 9, T_INT, T_STRING,
 		     T_STRING, T_LVALUE };
 
 /*
- * match a string possibly including %%, up to the next %[sdfc] or
- * the end of the string
+ * A sscanf format, compiled into a list of steps.  Literal text is
+ * stored with %% collapsed; text after the last conversion is dropped,
+ * since it does not affect the result.
  */
-static bool match(char *f, char *s, unsigned int *flenp, unsigned int *slenp)
+# define SF_LITERAL	0	/* literal text */
+# define SF_STRING	1	/* %s up to the end */
+# define SF_STRLIT	2	/* %s up to the following literal text */
+# define SF_STRINT	3	/* %s up to the following %d */
+# define SF_STRFLT	4	/* %s up to the following %f */
+# define SF_INT		5	/* %d */
+# define SF_FLOAT	6	/* %f */
+# define SF_CHAR	7	/* %c */
+# define SF_BAD		8	/* bad format string */
+
+struct ScanStep {
+    char type;			/* step type */
+    bool skip;			/* %*: no assignment */
+    unsigned int text;		/* offset of literal text */
+    unsigned int len;		/* length of literal text */
+};
+
+struct ScanFormat {
+    unsigned int flen;		/* length of format */
+    unsigned int nsteps;	/* # steps */
+    ScanStep *steps;		/* steps */
+    char *text;			/* literal text */
+    char *format;		/* format string */
+};
+
+static ScanFormat *sftab[SCANFTABSZ];	/* compiled formats */
+
+/*
+ * copy literal text up to the next % that is not %%
+ */
+static char *sf_literal(char *f, char *end, char *text, unsigned int *len)
 {
-    char *p;
-    unsigned int flen, slen;
+    while (f < end) {
+	if (*f == '%') {
+	    if (f[1] != '%') {
+		break;
+	    }
+	    f++;
+	}
+	text[(*len)++] = *f++;
+    }
+    return f;
+}
 
-    flen = *flenp;
-    slen = *slenp;
+/*
+ * compile a sscanf format string
+ */
+static ScanFormat *sf_compile(char *format, unsigned int flen)
+{
+    ScanStep *steps, *step;
+    char *text, *f, *end;
+    unsigned int tlen;
+    ScanFormat *sf;
+
+    steps = step = ALLOCA(ScanStep, flen + 1);
+    text = ALLOCA(char, flen + 1);
+    tlen = 0;
+
+    for (f = format, end = format + flen; f < end; step++) {
+	if (f[0] != '%' || f[1] == '%') {
+	    step->text = tlen;
+	    f = sf_literal(f, end, text, &tlen);
+	    if (f == end) {
+		break;
+	    }
+	    step->type = SF_LITERAL;
+	    step->skip = TRUE;
+	    step->len = tlen - step->text;
+	    step++;
+	}
 
-    while (flen > 0) {
-	/* look for first % */
-	p = (char *) memchr(f, '%', flen);
+	/* skip % and check for %* */
+	if (*++f == '*') {
+	    f++;
+	    step->skip = TRUE;
+	} else {
+	    step->skip = FALSE;
+	}
+
+	switch (*f++) {
+	case 's':
+	    if (f == end) {
+		step->type = SF_STRING;
+	    } else if (f[0] == '%' && f[1] != '%') {
+		switch ((f[1] == '*') ? f[2] : f[1]) {
+		case 'd':
+		    step->type = SF_STRINT;
+		    break;
 
-	if (p == (char *) NULL) {
-	    /* no remaining % */
-	    if (memcmp(f, s, flen) == 0) {
-		*slenp -= slen - flen;
-		return TRUE;
+		case 'f':
+		    step->type = SF_STRFLT;
+		    break;
+
+		default:
+		    step->type = SF_BAD;
+		    break;
+		}
 	    } else {
-		return FALSE;	/* no match */
+		step->type = SF_STRLIT;
+		step->text = tlen;
+		f = sf_literal(f, end, text, &tlen);
+		step->len = tlen - step->text;
 	    }
+	    break;
+
+	case 'd':
+	    step->type = SF_INT;
+	    break;
+
+	case 'f':
+	    step->type = SF_FLOAT;
+	    break;
+
+	case 'c':
+	    step->type = SF_CHAR;
+	    break;
+
+	default:
+	    step->type = SF_BAD;
+	    break;
 	}
 
-	if (p[1] == '%') {
-	    /* %% */
-	    if (memcmp(f, s, ++p - f) == 0) {
-		/* matched up to and including the first % */
-		s += p - f;
-		slen -= p - f;
-		flen -= ++p - f;
-		f = p;
-	    } else {
-		return FALSE;	/* no match */
-	    }
-	} else if (memcmp(f, s, p - f) == 0) {
-	    /* matched up to the first % */
-	    *flenp -= flen - (p - f);
-	    *slenp -= slen - (p - f);
-	    return TRUE;
-	} else {
-	    return FALSE;	/* no match */
+	if (step->type == SF_BAD) {
+	    /* the remainder is never reached */
+	    step++;
+	    break;
 	}
     }
 
-    *slenp -= slen;
-    return TRUE;
+    MM->staticMode();
+    sf = (ScanFormat *) ALLOC(char, sizeof(ScanFormat) +
+				    (step - steps) * sizeof(ScanStep) +
+				    tlen + flen);
+    MM->dynamicMode();
+    sf->flen = flen;
+    sf->nsteps = step - steps;
+    sf->steps = (ScanStep *) (sf + 1);
+    memcpy(sf->steps, steps, sf->nsteps * sizeof(ScanStep));
+    sf->text = (char *) (sf->steps + sf->nsteps);
+    memcpy(sf->text, text, tlen);
+    sf->format = sf->text + tlen;
+    memcpy(sf->format, format, flen);
+
+    AFREE(text);
+    AFREE(steps);
+    return sf;
+}
+
+/*
+ * find a compiled format, compiling it if needed; only short formats
+ * are kept
+ */
+static ScanFormat *sf_get(String *str)
+{
+    ScanFormat **s, *sf;
+
+    s = &sftab[Hashtab::hashkey(str->text, str->len) % SCANFTABSZ];
+    sf = *s;
+    if (sf != (ScanFormat *) NULL && sf->flen == str->len &&
+	memcmp(sf->format, str->text, str->len) == 0) {
+	return sf;
+    }
+
+    sf = sf_compile(str->text, str->len);
+    if (str->len <= SCANFMAXLEN) {
+	if (*s != (ScanFormat *) NULL) {
+	    FREE(*s);
+	}
+	*s = sf;
+    }
+    return sf;
 }
 
 /*
@@ -436,14 +564,15 @@ int kf_sscanf(Frame *f, int nargs, KFun *kf)
 	    char *text;			/* text of string */
 	};
     } results[MAX_LOCALS];
-    unsigned int flen, slen, size;
-    char *format, *x;
-    unsigned int fl, sl;
+    unsigned int slen, size;
+    char *x, *text;
     int matches;
     char *s;
     Int i;
     Float flt;
-    bool skip;
+    ScanFormat *sf;
+    ScanStep *step;
+    unsigned int n;
     Value *top, *elts;
     Array *a;
 
@@ -464,147 +593,94 @@ int kf_sscanf(Frame *f, int nargs, KFun *kf)
     if (top[0].type != T_STRING) {
 	return 2;
     }
-    format = top[0].string->text;
-    flen = top[0].string->len;
+    sf = sf_get(top[0].string);
 
     matches = 0;
     nargs = 0;
 
-    while (flen > 0) {
-	if (format[0] != '%' || format[1] == '%') {
-	    /* match initial part */
-	    fl = flen;
-	    sl = slen;
-	    if (!match(format, s, &fl, &sl) || fl == flen) {
+    for (step = sf->steps, n = sf->nsteps; n != 0; step++, --n) {
+	switch (step->type) {
+	case SF_LITERAL:
+	    /* literal text */
+	    if (slen < step->len || memcmp(s, sf->text + step->text,
+					   step->len) != 0) {
 		goto no_match;
 	    }
-	    format += fl;
-	    flen -= fl;
-	    s += sl;
-	    slen -= sl;
-	}
-
-	/* skip first % */
-	format++;
-	--flen;
-
-	/*
-	 * check for %*
-	 */
-	if (*format == '*') {
-	    /* no assignment */
-	    format++;
-	    --flen;
-	    skip = TRUE;
-	} else {
-	    skip = FALSE;
-	}
-
-	--flen;
-	switch (*format++) {
-	case 's':
-	    /* %s */
-	    if (format[0] == '%' && format[1] != '%') {
-		switch ((format[1] == '*') ? format[2] : format[1]) {
-		case 'd':
-		    /*
-		     * %s%d
-		     */
-		    size = slen;
-		    x = s;
-		    while (!isdigit(*x)) {
-			if (slen == 0) {
-			    goto no_match;
-			}
-			if (x[0] == '-' && isdigit(x[1])) {
-			    break;
-			}
-			x++;
-			--slen;
-		    }
-		    size -= slen;
-		    break;
+	    s += step->len;
+	    slen -= step->len;
+	    continue;
+
+	case SF_STRING:
+	    /* %s at the end: match whole string */
+	    size = slen;
+	    x = s + slen;
+	    slen = 0;
+	    break;
 
-		case 'f':
-		    /*
-		     * %s%f
-		     */
-		    size = slen;
-		    x = s;
-		    while (!isdigit(*x)) {
-			if (slen == 0) {
-			    goto no_match;
-			}
-			if ((x[0] == '-' || x[0] == '.') && isdigit(x[1])) {
-			    break;
-			}
-			x++;
-			--slen;
-		    }
-		    size -= slen;
+	case SF_STRLIT:
+	    /*
+	     * %s followed by literal text: find the first occurrence
+	     */
+	    text = sf->text + step->text;
+	    x = s;
+	    for (;;) {
+		size = slen - (x - s);
+		if (size < step->len) {
+		    goto no_match;
+		}
+		x = (char *) memchr(x, text[0], size - step->len + 1);
+		if (x == (char *) NULL) {
+		    goto no_match;
+		}
+		if (memcmp(x + 1, text + 1, step->len - 1) == 0) {
 		    break;
+		}
+		x++;
+	    }
+	    size = x - s;
+	    x += step->len;
+	    slen -= size + step->len;
+	    break;
 
-		default:
-		    EC->error("Bad sscanf format string");
+	case SF_STRINT:
+	    /*
+	     * %s%d
+	     */
+	    size = slen;
+	    x = s;
+	    while (!isdigit(*x)) {
+		if (slen == 0) {
+		    goto no_match;
 		}
-	    } else {
-		/*
-		 * %s followed by non-%
-		 */
-		if (flen == 0) {
-		    /* match whole string */
-		    size = slen;
-		    x = s + slen;
-		    slen = 0;
-		} else {
-		    /* get # of chars to match after string */
-		    for (x = format, size = 0; x - format != flen;
-			 x++, size++) {
-			x = (char *) memchr(x, '%', flen - (x - format));
-			if (x == (char *) NULL) {
-			    x = format + flen;
-			    break;
-			} else if (x[1] != '%') {
-			    break;
-			}
-		    }
-		    size = (x - format) - size;
-
-		    x = s;
-		    for (;;) {
-			sl = slen - (x - s);
-			if (sl < size) {
-			    goto no_match;
-			}
-			x = (char *) memchr(x, format[0], sl - size + 1);
-			if (x == (char *) NULL) {
-			    goto no_match;
-			}
-			fl = flen;
-			if (match(format, x, &fl, &sl)) {
-			    format += fl;
-			    flen -= fl;
-			    size = x - s;
-			    x += sl;
-			    slen -= size + sl;
-			    break;
-			}
-			x++;
-		    }
+		if (x[0] == '-' && isdigit(x[1])) {
+		    break;
 		}
+		x++;
+		--slen;
 	    }
+	    size -= slen;
+	    break;
 
-	    i_add_ticks(f, 8);
-	    if (!skip) {
-		results[nargs].type = T_STRING;
-		results[nargs].len = size;
-		results[nargs].text = s;
-		nargs++;
+	case SF_STRFLT:
+	    /*
+	     * %s%f
+	     */
+	    size = slen;
+	    x = s;
+	    while (!isdigit(*x)) {
+		if (slen == 0) {
+		    goto no_match;
+		}
+		if ((x[0] == '-' || x[0] == '.') && isdigit(x[1])) {
+		    break;
+		}
+		x++;
+		--slen;
 	    }
-	    s = x;
+	    size -= slen;
 	    break;
 
-	case 'd':
+	case SF_INT:
 	    /* %d */
 	    x = s;
 	    while (slen != 0 && *x == ' ') {
@@ -619,14 +695,15 @@ int kf_sscanf(Frame *f, int nargs, KFun *kf)
 	    slen -= (s - x);
 
 	    i_add_ticks(f, 8);
-	    if (!skip) {
+	    if (!step->skip) {
 		results[nargs].type = T_INT;
 		results[nargs].number = i;
 		nargs++;
 	    }
-	    break;
+	    matches++;
+	    continue;
 
-	case 'f':
+	case SF_FLOAT:
 	    /* %f */
 	    x = s;
 	    while (slen != 0 && *x == ' ') {
@@ -640,36 +717,54 @@ int kf_sscanf(Frame *f, int nargs, KFun *kf)
 	    slen -= (s - x);
 
 	    i_add_ticks(f, 8);
-	    if (!skip) {
+	    if (!step->skip) {
 		results[nargs].type = T_FLOAT;
 		results[nargs].fhigh = flt.high;
 		results[nargs].flow = flt.low;
 		nargs++;
 	    }
-	    break;
+	    matches++;
+	    continue;
 
-	case 'c':
+	case SF_CHAR:
 	    /* %c */
 	    if (slen == 0) {
 		goto no_match;
 	    }
 	    i_add_ticks(f, 8);
-	    if (!skip) {
+	    if (!step->skip) {
 		results[nargs].type = T_INT;
 		results[nargs].number = UCHAR(*s);
 		nargs++;
 	    }
 	    s++;
 	    --slen;
-	    break;
+	    matches++;
+	    continue;
 
 	default:
+	    if (sf->flen > SCANFMAXLEN) {
+		FREE(sf);	/* not cached */
+	    }
 	    EC->error("Bad sscanf format string");
 	}
+
+	/* %s */
+	i_add_ticks(f, 8);
+	if (!step->skip) {
+	    results[nargs].type = T_STRING;
+	    results[nargs].len = size;
+	    results[nargs].text = s;
+	    nargs++;
+	}
+	s = x;
 	matches++;
     }
 
 no_match:
+    if (sf->flen > SCANFMAXLEN) {
+	FREE(sf);	/* not cached */
+    }
     a = Array::create(f->data, nargs);
     for (elts = a->elts, size = 0; size < nargs; elts++, size++) {
 	switch (results[size].type) {
@@ -786,6 +881,78 @@ int kf_parse_string(Frame *f, int nargs, KFun *kf)
 # endif
 
 
+# ifdef FUNCDEF
+FUNCDEF("regexp_match", kf_regexp_match, pt_regexp_match, 0)
+# else
+char pt_regexp_match[] = { C_TYPECHECKED | C_STATIC, 2, 1, 0, 9,
+			   T_INT | (1 << REFSHIFT), T_STRING, T_STRING,
+			   T_INT };
+
+/*
+ * find the first match of a regular expression in a string.  Like the
+ * tokens of parse_string(), matches are never empty: where a regular
+ * expression can only match the empty string, as "x*" in "abc", the
+ * result is nil
+ */
+int kf_regexp_match(Frame *f, int nargs, KFun *kf)
+{
+    Int offset;
+    Array *a;
+
+    UNREFERENCED_PARAMETER(kf);
+
+    if (nargs > 2) {
+	offset = (f->sp++)->number;
+	if (offset < 0 || offset > f->sp[1].string->len) {
+	    return 3;
+	}
+    } else {
+	offset = 0;
+    }
+
+    a = Regexp::match(f, f->sp->string, f->sp[1].string, offset);
+    (f->sp++)->string->del();
+    f->sp->string->del();
+
+    if (a != (Array *) NULL) {
+	/* range of the match */
+	PUT_ARRVAL(f->sp, a);
+    } else {
+	/* no match */
+	*f->sp = Value::nil;
+    }
+    return 0;
+}
+# endif
+
+
+# ifdef FUNCDEF
+FUNCDEF("regexp_split", kf_regexp_split, pt_regexp_split, 0)
+# else
+char pt_regexp_split[] = { C_TYPECHECKED | C_STATIC, 2, 0, 0, 8,
+			   T_STRING | (1 << REFSHIFT), T_STRING, T_STRING };
+
+/*
+ * split a string at the matches of a regular expression, which are never
+ * empty
+ */
+int kf_regexp_split(Frame *f, int nargs, KFun *kf)
+{
+    Array *a;
+
+    UNREFERENCED_PARAMETER(nargs);
+    UNREFERENCED_PARAMETER(kf);
+
+    a = Regexp::split(f, f->sp->string, f->sp[1].string);
+    (f->sp++)->string->del();
+    f->sp->string->del();
+    PUT_ARRVAL(f->sp, a);
+
+    return 0;
+}
+# endif
+
+
 # ifdef FUNCDEF
 FUNCDEF("hash_crc16", kf_hash_crc16, pt_hash_crc16, 0)
 # else
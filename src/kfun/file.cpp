@@ -114,8 +114,27 @@ struct savecontext {
     char *buffer;		/* save/restore buffer */
     unsigned int bufsz;		/* size of save/restore buffer */
     Uint narrays;		/* number of arrays/mappings encountered */
+    Uint nstrings;		/* number of strings encountered */
 };
 
+/*
+ * binary save file format
+ */
+# define SAVE_MAGIC	"\000DGD"	/* binary save file magic */
+# define SAVE_MAGICSZ	4		/* size of magic */
+# define SAVE_VERSION	1		/* binary save file version */
+# define SAVE_HEADERSZ	5		/* magic + version */
+
+# define SV_NIL		0		/* nil */
+# define SV_INT		1		/* zigzag encoded integer */
+# define SV_FLOAT	2		/* float, 6 bytes */
+# define SV_STRING	3		/* length-prefixed string */
+# define SV_STRREF	4		/* reference to previous string */
+# define SV_ARRAY	5		/* array */
+# define SV_ARRREF	6		/* reference to previous array */
+# define SV_MAPPING	7		/* mapping */
+# define SV_MAPREF	8		/* reference to previous mapping */
+
 /*
  * output a number of characters
  */
@@ -361,8 +380,154 @@ static void save_mapping(savecontext *x, Array *a)
     put(x, "])", 2);
 }
 
-char pt_save_object[] = { C_TYPECHECKED | C_STATIC, 1, 0, 0, 7, T_VOID,
-			  T_STRING };
+/*
+ * output a variable-length unsigned number
+ */
+static void put_count(savecontext *x, Uint n)
+{
+    char buf[5];
+    unsigned int len;
+
+    for (len = 0; n >= 0x80; n >>= 7) {
+	buf[len++] = (n & 0x7f) | 0x80;
+    }
+    buf[len++] = n;
+    put(x, buf, len);
+}
+
+/*
+ * output a tag byte
+ */
+static void put_tag(savecontext *x, char tag)
+{
+    put(x, &tag, 1);
+}
+
+static void save_binmapping (savecontext*, Array*);
+
+/*
+ * save a value in binary format
+ */
+static void save_binary(savecontext *x, Value *v)
+{
+    char buf[6];
+    Uint i;
+    Value *elts;
+    Float flt;
+
+    switch (v->type) {
+    case T_NIL:
+	put_tag(x, SV_NIL);
+	break;
+
+    case T_INT:
+	put_tag(x, SV_INT);
+	put_count(x, ((Uint) v->number << 1) ^ (Uint) -(v->number < 0));
+	break;
+
+    case T_FLOAT:
+	GET_FLT(v, flt);
+	buf[0] = flt.high >> 8;
+	buf[1] = flt.high;
+	buf[2] = flt.low >> 24;
+	buf[3] = flt.low >> 16;
+	buf[4] = flt.low >> 8;
+	buf[5] = flt.low;
+	put_tag(x, SV_FLOAT);
+	put(x, buf, 6);
+	break;
+
+    case T_STRING:
+	i = v->string->put(x->nstrings);
+	if (i < x->nstrings) {
+	    /* same as some previous string */
+	    put_tag(x, SV_STRREF);
+	    put_count(x, i);
+	} else {
+	    x->nstrings++;
+	    put_tag(x, SV_STRING);
+	    put_count(x, v->string->len);
+	    put(x, v->string->text, v->string->len);
+	}
+	break;
+
+    case T_OBJECT:
+    case T_LWOBJECT:
+	if (Config::typechecking() >= 2) {
+	    put_tag(x, SV_NIL);
+	} else {
+	    put_tag(x, SV_INT);
+	    put_count(x, 0);
+	}
+	break;
+
+    case T_ARRAY:
+	i = v->array->put(x->narrays);
+	if (i < x->narrays) {
+	    /* same as some previous array */
+	    put_tag(x, SV_ARRREF);
+	    put_count(x, i);
+	    break;
+	}
+	x->narrays++;
+
+	put_tag(x, SV_ARRAY);
+	put_count(x, v->array->size);
+	for (i = v->array->size, elts = Dataspace::elts(v->array); i > 0; --i)
+	{
+	    save_binary(x, elts++);
+	}
+	break;
+
+    case T_MAPPING:
+	save_binmapping(x, v->array);
+	break;
+    }
+}
+
+/*
+ * save a mapping in binary format
+ */
+static void save_binmapping(savecontext *x, Array *a)
+{
+    Uint i;
+    uindex n;
+    Value *v;
+
+    i = a->put(x->narrays);
+    if (i < x->narrays) {
+	/* same as some previous mapping */
+	put_tag(x, SV_MAPREF);
+	put_count(x, i);
+	return;
+    }
+    x->narrays++;
+    a->mapCompact(a->primary->data);
+
+    /*
+     * skip index/value pairs of which either is an object
+     */
+    for (i = n = a->size >> 1, v = Dataspace::elts(a); i > 0; --i, v += 2) {
+	if (v[0].type == T_OBJECT || v[0].type == T_LWOBJECT ||
+	    v[1].type == T_OBJECT || v[1].type == T_LWOBJECT) {
+	    --n;
+	}
+    }
+    put_tag(x, SV_MAPPING);
+    put_count(x, n);
+
+    for (i = a->size >> 1, v = a->elts; i > 0; --i, v += 2) {
+	if (v[0].type == T_OBJECT || v[0].type == T_LWOBJECT ||
+	    v[1].type == T_OBJECT || v[1].type == T_LWOBJECT) {
+	    continue;
+	}
+	save_binary(x, &v[0]);
+	save_binary(x, &v[1]);
+    }
+}
+
+char pt_save_object[] = { C_TYPECHECKED | C_STATIC, 1, 1, 0, 8, T_VOID,
+			  T_STRING, T_INT };
 
 /*
  * save the variables of the current object
@@ -379,10 +544,11 @@ int kf_save_object(Frame *f, int n, KFun *kf)
     char file[STRINGSZ], buf[18], tmp[STRINGSZ + 8], *_tmp;
     savecontext x;
     Float flt;
+    bool binary;
 
-    UNREFERENCED_PARAMETER(n);
     UNREFERENCED_PARAMETER(kf);
 
+    binary = (n > 1 && (f->sp++)->number != 0);
     if (PM->string(file, f->sp->string->text,
 		   f->sp->string->len) == (char *) NULL) {
 	return 1;
@@ -410,6 +576,12 @@ int kf_save_object(Frame *f, int n, KFun *kf)
     ctrl = f->ctrl;
     Array::merge();
     x.narrays = 0;
+    if (binary) {
+	String::merge();
+	x.nstrings = 0;
+	put(&x, SAVE_MAGIC, SAVE_MAGICSZ);
+	put_tag(&x, SAVE_VERSION);
+    }
     if (f->lwobj != (Array *) NULL) {
 	var = &f->lwobj->elts[2];
     } else {
@@ -436,6 +608,14 @@ int kf_save_object(Frame *f, int n, KFun *kf)
 		     * don't save object values, nil or 0
 		     */
 		    str = ctrl->strconst(v->inherit, v->index);
+		    if (binary) {
+			put_count(&x, str->len);
+			put(&x, str->text, str->len);
+			save_binary(&x, var);
+			var++;
+			nvars++;
+			continue;
+		    }
 		    put(&x, str->text, str->len);
 		    put(&x, " ", 1);
 		    switch (var->type) {
@@ -473,6 +653,9 @@ int kf_save_object(Frame *f, int n, KFun *kf)
     }
 
     Array::clear();
+    if (binary) {
+	String::clear();
+    }
     if (x.bufsz > 0 && P_write(x.fd, x.buffer, x.bufsz) != x.bufsz) {
 	P_close(x.fd);
 	AFREE(x.buffer);
@@ -506,10 +689,16 @@ struct saveval : public ChunkAllocated {
 
 class vchunk : public Chunk<saveval, ACHUNKSZ> {
 public:
+    vchunk() : release(FALSE) { }
+
     /*
      * iterate through items until the right one is found
      */
     virtual bool item(saveval *v) {
+	if (release) {
+	    v->val.array->del();
+	    return TRUE;
+	}
 	if (--count == 0) {
 	    found = &v->val;
 	    return FALSE;
@@ -526,7 +715,17 @@ public:
 	return found;
     }
 
+    /*
+     * release the references held by the chunks
+     */
+    void del() {
+	release = TRUE;
+	items();
+	release = FALSE;
+    }
+
 private:
+    bool release;		/* releasing references? */
     Uint count;			/* index counter */
     Value *found;		/* value found */
 };
@@ -537,6 +736,20 @@ struct restcontext {
     vchunk alist;		/* list of array value chunks */
     Uint narrays;		/* # of arrays/mappings */
     char file[STRINGSZ];	/* current restore file */
+    int fd;			/* binary restore file descriptor */
+    char *buffer;		/* binary restore buffer */
+    unsigned int bufsz;		/* # bytes in binary restore buffer */
+    unsigned int bufpos;	/* position in binary restore buffer */
+    off_t offset;		/* file offset of binary restore buffer */
+    String **strings;		/* strings restored so far */
+    Uint nstrings;		/* # of strings */
+    Uint strsize;		/* size of string table */
+};
+
+struct restvar {
+    unsigned short offset;	/* variable offset */
+    Control *ctrl;		/* program defining the variable */
+    VarDef *vardef;		/* variable definition */
 };
 
 /*
@@ -856,6 +1069,269 @@ static char *restore_value(restcontext *x, char *buf, Value *val)
     }
 }
 
+/*
+ * handle an error while restoring a binary save file
+ */
+static void restore_binerror(restcontext *x, const char *err)
+{
+    EC->error("Format error in \"/%s\", offset %ld: %s", x->file,
+	      (long) (x->offset + x->bufpos), err);
+}
+
+/*
+ * read the next chunk of a binary save file
+ */
+static bool restore_fill(restcontext *x)
+{
+    int size;
+
+    x->offset += x->bufsz;
+    x->bufpos = 0;
+    size = P_read(x->fd, x->buffer, BUF_SIZE);
+    x->bufsz = (size > 0) ? size : 0;
+    return (x->bufsz != 0);
+}
+
+/*
+ * restore a byte
+ */
+static int restore_byte(restcontext *x)
+{
+    if (x->bufpos == x->bufsz && !restore_fill(x)) {
+	restore_binerror(x, "unexpected end of file");
+    }
+    return UCHAR(x->buffer[x->bufpos++]);
+}
+
+/*
+ * restore a number of bytes
+ */
+static void restore_bytes(restcontext *x, char *buf, unsigned int len)
+{
+    unsigned int chunk;
+
+    while (len != 0) {
+	if (x->bufpos == x->bufsz && !restore_fill(x)) {
+	    restore_binerror(x, "unexpected end of file");
+	}
+	chunk = x->bufsz - x->bufpos;
+	if (chunk > len) {
+	    chunk = len;
+	}
+	memcpy(buf, x->buffer + x->bufpos, chunk);
+	x->bufpos += chunk;
+	buf += chunk;
+	len -= chunk;
+    }
+}
+
+/*
+ * restore a variable-length unsigned number
+ */
+static Uint restore_count(restcontext *x)
+{
+    Uint n;
+    int c, shift;
+
+    n = 0;
+    for (shift = 0; ; shift += 7) {
+	c = restore_byte(x);
+	if (shift == 28 && c > 0x0f) {
+	    restore_binerror(x, "number too large");
+	}
+	n |= (Uint) (c & 0x7f) << shift;
+	if (!(c & 0x80)) {
+	    return n;
+	}
+    }
+}
+
+/*
+ * restore a value from a binary save file
+ */
+static void restore_binary(restcontext *x, Value *val)
+{
+    char buf[6];
+    Uint i;
+    Value *v;
+    Array *a;
+    String *str;
+    Float flt;
+    int tag;
+
+    switch (tag = restore_byte(x)) {
+    case SV_NIL:
+	*val = Value::nil;
+	break;
+
+    case SV_INT:
+	i = restore_count(x);
+	PUT_INTVAL(val, (Int) ((i >> 1) ^ -(i & 1)));
+	break;
+
+    case SV_FLOAT:
+	restore_bytes(x, buf, 6);
+	flt.high = (UCHAR(buf[0]) << 8) | UCHAR(buf[1]);
+	flt.low = ((Uint) UCHAR(buf[2]) << 24) | (UCHAR(buf[3]) << 16) |
+		  (UCHAR(buf[4]) << 8) | UCHAR(buf[5]);
+	if ((flt.high & 0x7ff0) == 0x7ff0) {
+	    restore_binerror(x, "illegal exponent");
+	}
+	PUT_FLTVAL(val, flt);
+	break;
+
+    case SV_STRING:
+	i = restore_count(x);
+	if (i > MAX_STRLEN) {
+	    restore_binerror(x, "string too long");
+	}
+	if (x->nstrings == x->strsize) {
+	    x->strings = REALLOC(x->strings, String*, x->strsize,
+				 x->strsize << 1);
+	    x->strsize <<= 1;
+	}
+	str = String::create((char *) NULL, i);
+	x->strings[x->nstrings++] = str;
+	str->ref();
+	restore_bytes(x, str->text, i);
+	PUT_STRVAL_NOREF(val, str);
+	break;
+
+    case SV_STRREF:
+	i = restore_count(x);
+	if (i >= x->nstrings) {
+	    restore_binerror(x, "bad string reference");
+	}
+	PUT_STRVAL_NOREF(val, x->strings[i]);
+	break;
+
+    case SV_ARRAY:
+    case SV_MAPPING:
+	i = restore_count(x);
+	if (tag == SV_ARRAY) {
+	    a = Array::create(x->f->data, i);
+	} else {
+	    a = Array::mapCreate(x->f->data, (long) i << 1);
+	}
+	/* the table keeps a reference until the restore is done */
+	ac_put(x, (tag == SV_ARRAY) ? T_ARRAY : T_MAPPING, a);
+	a->ref();
+	for (i = a->size, v = a->elts; i > 0; --i) {
+	    *v++ = Value::nil;
+	}
+	for (i = a->size, v = a->elts; i > 0; --i) {
+	    restore_binary(x, v);
+	    (v++)->ref();
+	}
+	if (tag == SV_MAPPING) {
+	    a->mapSort();
+	}
+	if (tag == SV_ARRAY) {
+	    PUT_ARRVAL_NOREF(val, a);
+	} else {
+	    PUT_MAPVAL_NOREF(val, a);
+	}
+	break;
+
+    case SV_ARRREF:
+    case SV_MAPREF:
+	i = restore_count(x);
+	if (i >= x->narrays) {
+	    restore_binerror(x, "bad array reference");
+	}
+	*val = *ac_get(x, i);
+	if (val->type != ((tag == SV_ARRREF) ? T_ARRAY : T_MAPPING)) {
+	    restore_binerror(x, "bad array reference");
+	}
+	break;
+
+    default:
+	restore_binerror(x, "bad value tag");
+    }
+}
+
+/*
+ * restore the variables of an object from a binary save file
+ */
+static void restore_binvars(restcontext *x, restvar *vars, unsigned short n)
+{
+    char name[STRINGSZ];
+    Frame *f;
+    Dataspace *data;
+    Value *var, tmp;
+    VarDef *v;
+    Uint len;
+    unsigned short i, j;
+
+    f = x->f;
+    data = f->data;
+    j = 0;
+    while (x->bufpos != x->bufsz || restore_fill(x)) {
+	/* variable name */
+	len = restore_count(x);
+	if (len >= STRINGSZ) {
+	    restore_binerror(x, "variable name too long");
+	}
+	restore_bytes(x, name, len);
+	name[len] = '\0';
+	restore_binary(x, &tmp);
+
+	/*
+	 * Variables are saved in order, so start looking where the last
+	 * one was found.
+	 */
+	for (i = n; i > 0; --i) {
+	    if (j == n) {
+		j = 0;
+	    }
+	    v = vars[j].vardef;
+	    if (strcmp(name, vars[j].ctrl->strconst(v->inherit,
+						    v->index)->text) == 0) {
+		break;
+	    }
+	    j++;
+	}
+	if (i == 0) {
+	    /* the saved variable is not in this object */
+	    tmp.ref();
+	    tmp.del();
+	    continue;
+	}
+
+	if (v->type != tmp.type && v->type != T_MIXED &&
+	    Config::typechecking() && (!VAL_NIL(&tmp) || !T_POINTER(v->type)) &&
+	    (tmp.type != T_ARRAY || (v->type & T_REF) == 0)) {
+	    tmp.ref();
+	    tmp.del();
+	    restore_binerror(x, "value has wrong type");
+	}
+	if (f->lwobj != (Array *) NULL) {
+	    var = &f->lwobj->elts[2 + vars[j].offset];
+	    data->assignElt(f->lwobj, var, &tmp);
+	} else {
+	    var = &data->variables[vars[j].offset];
+	    data->assignVar(var, &tmp);
+	}
+	j++;
+    }
+}
+
+/*
+ * clean up after restoring
+ */
+static void restore_clean(restcontext *x)
+{
+    x->alist.del();
+    x->alist.clean();
+    if (x->strings != (String **) NULL) {
+	while (x->nstrings != 0) {
+	    x->strings[--x->nstrings]->del();
+	}
+	FREE(x->strings);
+	x->strings = (String **) NULL;
+    }
+}
+
 char pt_restore_object[] = { C_TYPECHECKED | C_STATIC, 1, 0, 0, 7, T_INT,
 			     T_STRING };
 
@@ -876,8 +1352,9 @@ int kf_restore_object(Frame *f, int n, KFun *kf)
     restcontext x;
     Object *obj;
     int fd;
-    char *buffer, *name;
+    char *buffer, *name, header[SAVE_HEADERSZ];
     bool onstack, pending;
+    restvar *rvars, *rv;
 
     UNREFERENCED_PARAMETER(n);
     UNREFERENCED_PARAMETER(kf);
@@ -902,25 +1379,42 @@ int kf_restore_object(Frame *f, int n, KFun *kf)
 	P_close(fd);
 	return 0;
     }
-    buffer = ALLOCA(char, sbuf.st_size + 1);
-    if (buffer == (char *) NULL) {
-	buffer = ALLOC(char, sbuf.st_size + 1);
+    if (sbuf.st_size >= SAVE_HEADERSZ &&
+	P_read(fd, header, SAVE_HEADERSZ) == SAVE_HEADERSZ &&
+	memcmp(header, SAVE_MAGIC, SAVE_MAGICSZ) == 0) {
+	/*
+	 * binary save file, restored while reading
+	 */
+	if (header[SAVE_MAGICSZ] != SAVE_VERSION) {
+	    P_close(fd);
+	    EC->error("Unsupported save file version in \"/%s\"", x.file);
+	}
+	x.fd = fd;
+	buffer = (char *) NULL;
 	onstack = FALSE;
     } else {
-	onstack = TRUE;
-    }
-    if (P_read(fd, buffer, (unsigned int) sbuf.st_size) != sbuf.st_size) {
-	/* read failed (should never happen, but...) */
-	P_close(fd);
-	if (onstack) {
-	    AFREE(buffer);
+	x.fd = -1;
+	P_lseek(fd, 0, SEEK_SET);
+	buffer = ALLOCA(char, sbuf.st_size + 1);
+	if (buffer == (char *) NULL) {
+	    buffer = ALLOC(char, sbuf.st_size + 1);
+	    onstack = FALSE;
 	} else {
-	    FREE(buffer);
+	    onstack = TRUE;
 	}
-	return 0;
+	if (P_read(fd, buffer, (unsigned int) sbuf.st_size) != sbuf.st_size) {
+	    /* read failed (should never happen, but...) */
+	    P_close(fd);
+	    if (onstack) {
+		AFREE(buffer);
+	    } else {
+		FREE(buffer);
+	    }
+	    return 0;
+	}
+	buffer[sbuf.st_size] = '\0';
+	P_close(fd);
     }
-    buffer[sbuf.st_size] = '\0';
-    P_close(fd);
 
     /*
      * First, reset all non-static variables that do not hold object values.
@@ -932,6 +1426,8 @@ int kf_restore_object(Frame *f, int n, KFun *kf)
     } else {
 	var = data->variable(0);
     }
+    rv = rvars = (x.fd >= 0) ? ALLOCA(restvar, ctrl->nvariables) :
+			       (restvar *) NULL;
     nvars = 0;
     for (i = ctrl->ninherits, inh = ctrl->inherits; i > 0; --i, inh++) {
 	if (inh->varoffset == nvars) {
@@ -953,6 +1449,12 @@ int kf_restore_object(Frame *f, int n, KFun *kf)
 				     &Value::zeroInt : (v->type == T_FLOAT) ?
 					    &Value::zeroFloat : &Value::nil);
 		}
+		if (rvars != (restvar *) NULL && !(v->sclass & C_STATIC)) {
+		    rv->offset = nvars;
+		    rv->ctrl = ctrl;
+		    rv->vardef = v;
+		    rv++;
+		}
 		var++;
 		nvars++;
 	    }
@@ -962,6 +1464,34 @@ int kf_restore_object(Frame *f, int n, KFun *kf)
     x.line = 1;
     x.f = f;
     x.narrays = 0;
+    x.strings = (String **) NULL;
+    x.nstrings = 0;
+    if (x.fd >= 0) {
+	x.buffer = ALLOCA(char, BUF_SIZE);
+	x.bufsz = x.bufpos = 0;
+	x.offset = SAVE_HEADERSZ;
+	x.strsize = 64;
+	x.strings = ALLOC(String*, x.strsize);
+	try {
+	    EC->push();
+	    restore_binvars(&x, rvars, rv - rvars);
+	    EC->pop();
+	} catch (...) {
+	    /* error; clean up */
+	    restore_clean(&x);
+	    AFREE(x.buffer);
+	    AFREE(rvars);
+	    P_close(x.fd);
+	    EC->error((char *) NULL);	/* pass on error */
+	}
+	restore_clean(&x);
+	AFREE(x.buffer);
+	AFREE(rvars);
+	P_close(x.fd);
+	f->sp->number = 1;
+	return 0;
+    }
+
     buf = buffer;
     pending = FALSE;
     try {
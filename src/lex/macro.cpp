@@ -44,6 +44,53 @@ public:
 
 static Hashtab *mt;		/* macro hash table */
 
+/*
+ * A macro looked at or changed by an include file, with its replacement
+ * text before and after the inclusion.  NULL means undefined.
+ */
+struct MacroDef {
+    char *name;			/* macro name */
+    char *before;		/* replacement before */
+    char *after;		/* replacement after */
+    short nbefore;		/* # arguments before */
+    short nafter;		/* # arguments after */
+};
+
+/*
+ * The effect of an include file on the macro table.  An include file
+ * which does nothing but define macros can be replayed from this, as
+ * long as the macros it looks at are in the same state.
+ */
+class Header : public Hashtab::Entry, public Allocated {
+public:
+    Header(const char *file);
+    virtual ~Header();
+
+    FileStamp stamp;		/* version of the file */
+    bool pure;			/* only preprocessor directives? */
+    int ndefs;			/* # macros */
+    MacroDef *defs;		/* macros looked at or changed */
+};
+
+/*
+ * First access to a macro while recording an include file.
+ */
+class Touch : public Hashtab::Entry, public Allocated {
+public:
+    Touch(const char *name, Macro *mac);
+    virtual ~Touch();
+
+    char *replace;		/* replacement before */
+    int narg;			/* # arguments before */
+    Touch *link;		/* next in list */
+};
+
+static Hashtab *ht;		/* include file cache, in static memory */
+static Hashtab *tt;		/* touched macros, when recording */
+static Touch *tlist;		/* list of touched macros */
+static int ntouch;		/* # touched macros */
+static bool special;		/* predefined macro touched? */
+
 /*
  * intiialize the macro table
  */
@@ -57,6 +104,7 @@ void Macro::init()
  */
 void Macro::clear()
 {
+    record(FALSE);
     if (mt != (Hashtab *) NULL) {
 	delete mt;
 	mt = (Hashtab *) NULL;
@@ -98,6 +146,9 @@ void Macro::define(const char *name, const char *replace, int narg)
     Macro *mac;
 
     m = mt->lookup(name, FALSE);
+    if (tt != (Hashtab *) NULL) {
+	touch(name, (Macro *) *m);
+    }
     if ((Macro *) *m != (Macro *) NULL) {
 	/* the macro already exists. */
 	mac = (Macro *) *m;
@@ -128,6 +179,9 @@ void Macro::undef(char *name)
     Macro *mac;
 
     m = mt->lookup(name, FALSE);
+    if (tt != (Hashtab *) NULL) {
+	touch(name, (Macro *) *m);
+    }
     if ((Macro *) *m != (Macro *) NULL) {
 	/* it really exists. */
 	mac = (Macro *) *m;
@@ -142,5 +196,240 @@ void Macro::undef(char *name)
  */
 Macro *Macro::lookup(char *name)
 {
-    return (Macro *) *mt->lookup(name, TRUE);
+    Macro *mac;
+
+    mac = (Macro *) *mt->lookup(name, TRUE);
+    if (tt != (Hashtab *) NULL) {
+	touch(name, mac);
+    }
+    return mac;
+}
+
+/*
+ * constructor
+ */
+Touch::Touch(const char *name, Macro *mac)
+{
+    next = (Hashtab::Entry *) NULL;
+    this->name = strcpy(ALLOC(char, strlen(name) + 1), name);
+    if (mac != (Macro *) NULL && mac->replace != (char *) NULL) {
+	replace = strcpy(ALLOC(char, strlen(mac->replace) + 1), mac->replace);
+	narg = mac->narg;
+    } else {
+	replace = (char *) NULL;
+	narg = 0;
+    }
+}
+
+/*
+ * destructor
+ */
+Touch::~Touch()
+{
+    FREE((char *) name);
+    if (replace != (char *) NULL) {
+	FREE(replace);
+    }
+}
+
+/*
+ * remember the state of a macro when first accessed during recording
+ */
+void Macro::touch(const char *name, Macro *mac)
+{
+    Hashtab::Entry **t;
+    Touch *tch;
+
+    t = tt->lookup(name, FALSE);
+    if (*t == (Hashtab::Entry *) NULL) {
+	if (mac != (Macro *) NULL && mac->replace == (char *) NULL) {
+	    special = TRUE;	/* expansion depends on context */
+	}
+	*t = tch = new Touch(name, mac);
+	tch->link = tlist;
+	tlist = tch;
+	ntouch++;
+    }
+}
+
+/*
+ * start (TRUE) or stop (FALSE) recording the macros accessed by an
+ * include file
+ */
+void Macro::record(bool flag)
+{
+    Touch *tch;
+
+    if (tt != (Hashtab *) NULL) {
+	while (tlist != (Touch *) NULL) {
+	    tch = tlist;
+	    tlist = tch->link;
+	    delete tch;
+	}
+	delete tt;
+	tt = (Hashtab *) NULL;
+    }
+    if (flag) {
+	tt = Hashtab::create(TOUCHTABSZ, MACHASHSZ, FALSE);
+	ntouch = 0;
+	special = FALSE;
+    }
+}
+
+/*
+ * constructor
+ */
+Header::Header(const char *file)
+{
+    next = (Hashtab::Entry *) NULL;
+    name = strcpy(ALLOC(char, strlen(file) + 1), file);
+    ndefs = 0;
+    defs = (MacroDef *) NULL;
+}
+
+/*
+ * destructor
+ */
+Header::~Header()
+{
+    if (defs != (MacroDef *) NULL) {
+	FREE(defs);
+    }
+    FREE((char *) name);
+}
+
+/*
+ * store the effect of the recorded include file in the cache, and stop
+ * recording
+ */
+void Macro::save(const char *file, FileStamp *stamp, bool pure)
+{
+    Hashtab::Entry **e;
+    Header *h;
+    MacroDef *d;
+    Touch *tch;
+    Macro *mac;
+    char *text;
+    size_t len;
+
+    if (tt == (Hashtab *) NULL) {
+	return;
+    }
+
+    MM->staticMode();
+    if (ht == (Hashtab *) NULL) {
+	ht = Hashtab::create(HDRTABSZ, STRINGSZ, FALSE);
+    }
+    e = ht->lookup(file, FALSE);
+    if (*e != (Hashtab::Entry *) NULL) {
+	/* replace outdated entry */
+	h = (Header *) *e;
+	*e = h->next;
+	delete h;
+    }
+    h = new Header(file);
+    h->next = *e;
+    *e = h;
+    h->stamp = *stamp;
+    h->pure = (pure && !special);
+    if (h->pure && ntouch != 0) {
+	/*
+	 * macro states and their texts are kept in a single block
+	 */
+	len = ntouch * sizeof(MacroDef);
+	for (tch = tlist; tch != (Touch *) NULL; tch = tch->link) {
+	    len += strlen(tch->name) + 1;
+	    if (tch->replace != (char *) NULL) {
+		len += strlen(tch->replace) + 1;
+	    }
+	    mac = (Macro *) *mt->lookup(tch->name, FALSE);
+	    if (mac != (Macro *) NULL) {
+		len += strlen(mac->replace) + 1;
+	    }
+	}
+	h->defs = d = (MacroDef *) ALLOC(char, len);
+	h->ndefs = ntouch;
+	text = (char *) (d + ntouch);
+
+	for (tch = tlist; tch != (Touch *) NULL; tch = tch->link, d++) {
+	    d->name = strcpy(text, tch->name);
+	    text += strlen(text) + 1;
+	    if (tch->replace != (char *) NULL) {
+		d->before = strcpy(text, tch->replace);
+		text += strlen(text) + 1;
+	    } else {
+		d->before = (char *) NULL;
+	    }
+	    d->nbefore = tch->narg;
+	    mac = (Macro *) *mt->lookup(tch->name, FALSE);
+	    if (mac != (Macro *) NULL) {
+		d->after = strcpy(text, mac->replace);
+		text += strlen(text) + 1;
+		d->nafter = mac->narg;
+	    } else {
+		d->after = (char *) NULL;
+		d->nafter = 0;
+	    }
+	}
+    }
+    MM->dynamicMode();
+
+    record(FALSE);
+}
+
+/*
+ * Replay the effect of an include file from the cache.  Return TRUE if
+ * this succeeded, and set cached to TRUE if there is an up-to-date entry
+ * for the file (whether or not it could be replayed).
+ */
+bool Macro::replay(const char *file, FileStamp *stamp, bool *cached)
+{
+    Header *h;
+    MacroDef *d;
+    Macro *mac;
+    int i;
+
+    *cached = FALSE;
+    if (ht == (Hashtab *) NULL) {
+	return FALSE;
+    }
+    h = (Header *) *ht->lookup(file, TRUE);
+    if (h == (Header *) NULL || h->stamp.mtime != stamp->mtime ||
+	h->stamp.ctime != stamp->ctime || h->stamp.inode != stamp->inode ||
+	h->stamp.size != stamp->size) {
+	return FALSE;
+    }
+    *cached = TRUE;
+    if (!h->pure) {
+	return FALSE;
+    }
+
+    /* the macros must be in the same state as when recorded */
+    for (d = h->defs, i = h->ndefs; i != 0; d++, --i) {
+	mac = (Macro *) *mt->lookup(d->name, FALSE);
+	if (mac == (Macro *) NULL) {
+	    if (d->before != (char *) NULL) {
+		return FALSE;
+	    }
+	} else if (d->before == (char *) NULL ||
+		   mac->replace == (char *) NULL || mac->narg != d->nbefore ||
+		   strcmp(mac->replace, d->before) != 0) {
+	    return FALSE;
+	}
+    }
+
+    for (d = h->defs, i = h->ndefs; i != 0; d++, --i) {
+	if (d->before == (char *) NULL) {
+	    if (d->after != (char *) NULL) {
+		define(d->name, d->after, d->nafter);
+	    }
+	} else if (d->after == (char *) NULL) {
+	    undef(d->name);
+	} else if (d->nafter != d->nbefore ||
+		   strcmp(d->after, d->before) != 0) {
+	    undef(d->name);
+	    define(d->name, d->after, d->nafter);
+	}
+    }
+    return TRUE;
 }
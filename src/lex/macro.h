@@ -19,6 +19,16 @@
 
 # include "hash.h"
 
+/*
+ * identifies the version of an include file in the cache
+ */
+struct FileStamp {
+    Uint mtime;			/* modification time */
+    Uint ctime;			/* status change time */
+    Uint inode;			/* inode number */
+    Uint size;			/* file size */
+};
+
 class Macro : public Hashtab::Entry, public ChunkAllocated {
 public:
     Macro(const char *name);
@@ -29,9 +39,15 @@ public:
     static void define(const char *name, const char *replace, int narg);
     static void undef(char *name);
     static Macro *lookup(char *name);
+    static void record(bool flag);
+    static void save(const char *file, FileStamp *stamp, bool pure);
+    static bool replay(const char *file, FileStamp *stamp, bool *cached);
 
     char *replace;		/* replace text */
     int narg;			/* number of arguments */
+
+private:
+    static void touch(const char *name, Macro *mac);
 };
 
 # define MA_NARG	0x1f
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+# define INCLUDE_FILE_IO
 # include "lex.h"
 # include "macro.h"
 # include "special.h"
@@ -49,6 +50,13 @@ static Chunk<IFState, ICHUNKSZ> ichunk;
 static int include_level;	/* current #include level */
 static IFState *ifs;		/* current conditional inclusion state */
 
+extern int nerrors;		/* # of errors during parsing */
+
+static char *rec_file;		/* include file being recorded */
+static FileStamp rec_stamp;	/* its version */
+static int rec_level;		/* its include level */
+static int rec_errors;		/* # errors when it was included */
+
 /*
  * push a new ifstate on the stack
  */
@@ -144,6 +152,10 @@ bool PP::init(char *file, char **id, String **strs, int nstr, int level)
  */
 void PP::clear()
 {
+    if (rec_file != (char *) NULL) {
+	FREE(rec_file);
+	rec_file = (char *) NULL;
+    }
     Str::clear();
     while (ifs != &top) {
 	ifs->pop();
@@ -437,6 +449,67 @@ void PP::unexpected(int token, const char *wanted, const char *directive)
     }
 }
 
+/*
+ * push a file on the input stream, or replay its effect on the macro
+ * table from the cache
+ */
+bool PP::include(char *file, String **strs, int nstr)
+{
+    struct stat sbuf;
+    FileStamp stamp;
+    bool cached;
+
+    if (file == (char *) NULL) {
+	return FALSE;
+    }
+    if (rec_file != (char *) NULL) {
+	endRecord(FALSE);	/* nested includes are not cached */
+    }
+
+    cached = TRUE;
+    if (strs == (String **) NULL && P_stat(file, &sbuf) >= 0 &&
+	(sbuf.st_mode & S_IFMT) == S_IFREG) {
+	stamp.mtime = (Uint) sbuf.st_mtime;
+	stamp.ctime = (Uint) sbuf.st_ctime;
+	stamp.inode = (Uint) sbuf.st_ino;
+	stamp.size = (Uint) sbuf.st_size;
+	if (Macro::replay(file, &stamp, &cached)) {
+	    return TRUE;
+	}
+	if (stamp.ctime >= P_time()) {
+	    /*
+	     * changed within the current second: a further change in the
+	     * same second could not be told apart, so don't cache it yet
+	     */
+	    cached = TRUE;
+	}
+    }
+    if (!TokenBuf::include(file, strs, nstr)) {
+	return FALSE;
+    }
+    include_level++;
+
+    if (!cached) {
+	/* record the effect of this file on the macro table */
+	rec_file = strcpy(ALLOC(char, strlen(file) + 1), file);
+	rec_stamp = stamp;
+	rec_level = include_level;
+	rec_errors = nerrors;
+	Macro::record(TRUE);
+    }
+    return TRUE;
+}
+
+/*
+ * finish recording an include file
+ */
+void PP::endRecord(bool pure)
+{
+    Macro::save(rec_file, &rec_stamp, pure && nerrors == rec_errors);
+    FREE(rec_file);
+    rec_file = (char *) NULL;
+}
+
 /*
  * handle an #include preprocessing directive
  */
@@ -469,8 +542,7 @@ void PP::do_include()
 
 	/* first try the path direct */
 	include = PM->include(buf, TokenBuf::filename(), file, &strs, &nstr);
-	if (TokenBuf::include(include, strs, nstr)) {
-	    include_level++;
+	if (PP::include(include, strs, nstr)) {
 	    return;
 	}
     } else if (token == INCL_CONST) {
@@ -487,8 +559,7 @@ void PP::do_include()
 	strcat(path, "/");
 	strcat(path, file);
 	include = PM->include(buf, TokenBuf::filename(), path, &strs, &nstr);
-	if (TokenBuf::include(include, strs, nstr)) {
-	    include_level++;
+	if (PP::include(include, strs, nstr)) {
 	    return;
 	}
     }
@@ -685,7 +756,7 @@ void PP::do_define()
  * get a preprocessed token from the input stream, handling
  * preprocessor directives.
  */
-int PP::gettok()
+int PP::pptoken()
 {
     int token;
     Macro *mc;
@@ -709,6 +780,9 @@ int PP::gettok()
 		ifs->pop();
 	    }
 	    if (include_level > 0) {
+		if (rec_file != (char *) NULL && include_level == rec_level) {
+		    endRecord(TRUE);
+		}
 		--include_level;
 		TokenBuf::endinclude();
 		continue;
@@ -971,3 +1045,18 @@ int PP::gettok()
 	}
     }
 }
+
+/*
+ * get a preprocessed token.  An include file that yields tokens is more
+ * than a list of macro definitions, and cannot be replayed.
+ */
+int PP::gettok()
+{
+    int token;
+
+    token = pptoken();
+    if (rec_file != (char *) NULL) {
+	endRecord(FALSE);
+    }
+    return token;
+}
@@ -21,9 +21,12 @@ class PP {
 public:
     static bool init(char *file, char **id, String **strs, int nstr, int level);
     static void clear();
+    static bool include(char *file, String **strs, int nstr);
     static int gettok();
 
 private:
+    static void endRecord(bool pure);
+    static int pptoken();
     static int wsgettok();
     static int mcgtok();
     static int wsmcgtok();
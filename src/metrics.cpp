@@ -0,0 +1,577 @@
+/*
+ * This file is part of DGD, https://github.com/dworkin/dgd
+ * Copyright (C) 1993-2010 Dworkin B.V.
+ * Copyright (C) 2010-2021 DGD Authors (see the commit log for details)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+# define INCLUDE_FILE_IO
+# include "dgd.h"
+# include "str.h"
+# include "array.h"
+# include "object.h"
+# include "interpret.h"
+# include "metrics.h"
+# include <stdarg.h>
+
+/*
+ * Counters and latency histograms, written to a file in Prometheus text
+ * format once per second, and a ring file of slow tasks with the time
+ * spent per phase.  Nothing is timed unless one of the files is
+ * configured.
+ */
+
+struct Bucket {
+    Uuint bound;		/* upper bound, inclusive */
+    const char *le;		/* bound as exported */
+};
+
+class Histogram {
+public:
+    void add(Uuint value, Uint n);
+    void report(class Report *r, const char *name, const char *help,
+		Uuint scale);
+
+    const Bucket *buckets;	/* bucket bounds */
+    int nbuckets;		/* # bucket bounds */
+    Uuint count[24];		/* counts per bucket, plus +Inf */
+    Uuint total;		/* # values */
+    Uuint sum;			/* sum of values */
+};
+
+/* microseconds */
+static const Bucket usec[] = {
+    { 10, "0.00001" }, { 25, "0.000025" }, { 50, "0.00005" },
+    { 100, "0.0001" }, { 250, "0.00025" }, { 500, "0.0005" },
+    { 1000, "0.001" }, { 2500, "0.0025" }, { 5000, "0.005" },
+    { 10000, "0.01" }, { 25000, "0.025" }, { 50000, "0.05" },
+    { 100000, "0.1" }, { 250000, "0.25" }, { 500000, "0.5" },
+    { 1000000, "1" }, { 2500000, "2.5" }, { 5000000, "5" },
+    { 10000000, "10" }
+};
+
+/* milliseconds */
+static const Bucket msec[] = {
+    { 1, "0.001" }, { 5, "0.005" }, { 10, "0.01" }, { 50, "0.05" },
+    { 100, "0.1" }, { 500, "0.5" }, { 1000, "1" }, { 2000, "2" },
+    { 5000, "5" }, { 10000, "10" }, { 60000, "60" }
+};
+
+/* ticks */
+static const Bucket ticks[] = {
+    { 100, "100" }, { 1000, "1000" }, { 10000, "10000" },
+    { 100000, "100000" }, { 1000000, "1e+06" }, { 10000000, "1e+07" },
+    { 100000000, "1e+08" }, { 1000000000, "1e+09" }
+};
+
+# define NBUCKETS(b)	(sizeof(b) / sizeof(Bucket))
+
+struct PortIO {
+    Uuint in;			/* bytes received */
+    Uuint out;			/* bytes sent */
+};
+
+class Report {
+public:
+    Report(int fd) : fd(fd), size(0) { }
+
+    void printf(const char *format, ...);
+    void flush();
+
+private:
+    int fd;			/* output file */
+    unsigned int size;		/* size of buffered output */
+    char buffer[BUF_SIZE];	/* output buffer */
+};
+
+Uuint Metrics::swapMisses, Metrics::swapReads, Metrics::swapWrites;
+Uuint Metrics::loadBytes, Metrics::saveBytes;
+Uuint Metrics::dataHits, Metrics::dataMisses;
+Uuint Metrics::ctrlHits, Metrics::ctrlMisses;
+
+static char *mfile;		/* metrics file, or NULL */
+static Uint mtime;		/* time of last report */
+static bool timing;		/* time tasks? */
+static Uuint tstart;		/* start of current task */
+static Int tticks;		/* ticks left at start of current task */
+static Uuint istart;		/* start of select() wait */
+static int tfd = -1;		/* slow task ring file */
+static Uuint threshold;		/* slow task threshold in microseconds */
+static TraceHeader theader;	/* ring file header */
+static TraceRecord trec;	/* current task */
+static int cphase;		/* current phase */
+static Uuint pstart;		/* start of current phase */
+static bool root;		/* first function of task seen? */
+static Histogram tasktime;	/* task duration */
+static Histogram taskticks;	/* ticks per task */
+static Histogram selwait;	/* select() wait */
+static Histogram colag;		/* callout lag */
+static unsigned short *pnum;	/* port numbers */
+static char *ptype;		/* port types */
+static PortIO *pio;		/* bytes in/out per port */
+static int nports;		/* # ports, excluding outbound */
+
+/*
+ * add a value to a histogram
+ */
+void Histogram::add(Uuint value, Uint n)
+{
+    int i;
+
+    for (i = 0; i < nbuckets && value > buckets[i].bound; i++) ;
+    count[i] += n;
+    total += n;
+    sum += value * n;
+}
+
+/*
+ * export a histogram, with values divided by scale
+ */
+void Histogram::report(Report *r, const char *name, const char *help,
+		       Uuint scale)
+{
+    Uuint n;
+    int i;
+
+    r->printf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    n = 0;
+    for (i = 0; i < nbuckets; i++) {
+	n += count[i];
+	r->printf("%s_bucket{le=\"%s\"} %llu\n", name, buckets[i].le,
+		  (unsigned long long) n);
+    }
+    r->printf("%s_bucket{le=\"+Inf\"} %llu\n", name,
+	      (unsigned long long) total);
+    if (scale == 1) {
+	r->printf("%s_sum %llu\n", name, (unsigned long long) sum);
+    } else {
+	r->printf("%s_sum %llu.%0*llu\n", name,
+		  (unsigned long long) (sum / scale),
+		  (scale == 1000) ? 3 : 6, (unsigned long long) (sum % scale));
+    }
+    r->printf("%s_count %llu\n", name, (unsigned long long) total);
+}
+
+/*
+ * append formatted text to the report
+ */
+void Report::printf(const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if (size > BUF_SIZE - 512) {
+	flush();
+    }
+    va_start(args, format);
+    len = vsnprintf(buffer + size, BUF_SIZE - size, format, args);
+    va_end(args);
+    if (len > 0) {
+	if ((unsigned int) len >= BUF_SIZE - size) {
+	    len = BUF_SIZE - 1 - size;
+	}
+	size += len;
+    }
+}
+
+/*
+ * write buffered output
+ */
+void Report::flush()
+{
+    if (size != 0) {
+	(void) P_write(fd, buffer, size);
+	size = 0;
+    }
+}
+
+/*
+ * initialize metrics, if a file is configured
+ */
+void Metrics::init(char *file, unsigned short *tports, int ntports,
+		   unsigned short *bports, int nbports,
+		   unsigned short *dports, int ndports)
+{
+    int i;
+
+    if (file == (char *) NULL) {
+	return;
+    }
+    mfile = strcpy(ALLOC(char, strlen(file) + 1), file);
+
+    nports = ntports + nbports + ndports;
+    pnum = ALLOC(unsigned short, nports);
+    ptype = ALLOC(char, nports);
+    pio = ALLOC(PortIO, nports + 1);
+    memset(pio, '\0', (nports + 1) * sizeof(PortIO));
+    for (i = 0; i < ntports; i++) {
+	pnum[i] = tports[i];
+	ptype[i] = MP_TELNET;
+    }
+    for (i = 0; i < nbports; i++) {
+	pnum[ntports + i] = bports[i];
+	ptype[ntports + i] = MP_BINARY;
+    }
+    for (i = 0; i < ndports; i++) {
+	pnum[ntports + nbports + i] = dports[i];
+	ptype[ntports + nbports + i] = MP_DGRAM;
+    }
+
+    tasktime.buckets = selwait.buckets = usec;
+    tasktime.nbuckets = selwait.nbuckets = NBUCKETS(usec);
+    taskticks.buckets = ticks;
+    taskticks.nbuckets = NBUCKETS(ticks);
+    colag.buckets = msec;
+    colag.nbuckets = NBUCKETS(msec);
+
+    timing = TRUE;
+    tstart = P_utime();
+}
+
+/*
+ * start logging tasks that take longer than msec milliseconds
+ */
+void Metrics::trace(char *file, Uint msec)
+{
+    char buf[STRINGSZ], *p;
+
+    p = path_native(buf, file);
+    tfd = P_open(p, O_CREAT | O_RDWR | O_BINARY, 0644);
+    if (tfd < 0) {
+	EC->message("Cannot open trace file \"%s\"\012", file);	/* LF */
+	return;
+    }
+    if (P_read(tfd, (char *) &theader, sizeof(TraceHeader)) !=
+						sizeof(TraceHeader) ||
+	theader.magic != TRACE_MAGIC || theader.version != TRACE_VERSION ||
+	theader.size != sizeof(TraceRecord) || theader.nrecords != TRACESZ) {
+	/*
+	 * start a new ring
+	 */
+	theader.magic = TRACE_MAGIC;
+	theader.version = TRACE_VERSION;
+	theader.size = sizeof(TraceRecord);
+	theader.nrecords = TRACESZ;
+	theader.next = theader.count = 0;
+	P_lseek(tfd, 0, SEEK_SET);
+	(void) P_write(tfd, (char *) &theader, sizeof(TraceHeader));
+    }
+    threshold = (Uuint) msec * 1000;
+
+    timing = TRUE;
+    tstart = pstart = P_utime();
+    trec.mstart = MM->info()->dmemused;
+}
+
+/*
+ * stop recording metrics
+ */
+void Metrics::finish()
+{
+    if (mfile != (char *) NULL) {
+	report();
+	FREE(mfile);
+	FREE(pnum);
+	FREE(ptype);
+	FREE(pio);
+	mfile = (char *) NULL;
+    }
+    if (tfd >= 0) {
+	P_close(tfd);
+	tfd = -1;
+    }
+    timing = FALSE;
+}
+
+/*
+ * start waiting for input
+ */
+void Metrics::idle()
+{
+    if (timing) {
+	istart = P_utime();
+    }
+}
+
+/*
+ * prepare to account for a new task
+ */
+static void newTask(Uuint time)
+{
+    tstart = pstart = time;
+    tticks = cframe->rlim->ticks;
+    if (tfd >= 0) {
+	memset(trec.phase, '\0', sizeof(trec.phase));
+	trec.mstart = MM->info()->dmemused;
+	root = FALSE;
+    }
+    cphase = MT_INTERPRET;
+}
+
+/*
+ * input has arrived, or the wait has timed out: start the next task
+ */
+void Metrics::startTask()
+{
+    Uuint time;
+
+    if (timing) {
+	time = P_utime();
+	if (mfile != (char *) NULL) {
+	    selwait.add(time - istart, 1);
+	}
+	newTask(time);
+    }
+}
+
+/*
+ * a task has ended; the next one starts now
+ */
+void Metrics::endTask()
+{
+    Uuint time, duration;
+    Int left;
+    bool valid;
+
+    if (timing) {
+	time = P_utime();
+	duration = time - tstart;
+
+	/*
+	 * ticks are charged to the top level rlimits scope; skip the value
+	 * if the tick counter wrapped during this task
+	 */
+	left = cframe->rlim->ticks;
+	valid = (left <= tticks);
+
+	if (mfile != (char *) NULL) {
+	    tasktime.add(duration, 1);
+	    if (valid) {
+		taskticks.add(tticks - left, 1);
+	    }
+	}
+
+	if (tfd >= 0 && duration >= threshold) {
+	    /*
+	     * log slow task
+	     */
+	    trec.phase[cphase] += time - pstart;
+	    trec.time = P_time();
+	    trec.ticks = (valid) ? tticks - left : 0;
+	    trec.duration = duration;
+	    trec.mend = MM->info()->dmemused;
+	    if (!root) {
+		trec.object[0] = trec.function[0] = '\0';
+	    }
+	    P_lseek(tfd, sizeof(TraceHeader) +
+			 (off_t) theader.next * sizeof(TraceRecord), SEEK_SET);
+	    (void) P_write(tfd, (char *) &trec, sizeof(TraceRecord));
+	    theader.next = (theader.next + 1) % theader.nrecords;
+	    theader.count++;
+	    P_lseek(tfd, 0, SEEK_SET);
+	    (void) P_write(tfd, (char *) &theader, sizeof(TraceHeader));
+	}
+
+	newTask(time);
+    }
+}
+
+/*
+ * enter a new phase of the current task, and return the previous one
+ */
+int Metrics::phase(int phase)
+{
+    Uuint time;
+    int prev;
+
+    prev = cphase;
+    if (tfd >= 0 && phase != prev) {
+	time = P_utime();
+	trec.phase[prev] += time - pstart;
+	pstart = time;
+    }
+    cphase = phase;
+    return prev;
+}
+
+/*
+ * a function is called from the top level; remember the first one
+ */
+void Metrics::call(Object *obj, const char *func, unsigned int len)
+{
+    char buf[STRINGSZ + 12];
+
+    if (tfd >= 0 && !root) {
+	root = TRUE;
+	strncpy(trec.object, obj->objName(buf), STRINGSZ - 1);
+	trec.object[STRINGSZ - 1] = '\0';
+	if (len >= STRINGSZ) {
+	    len = STRINGSZ - 1;
+	}
+	memcpy(trec.function, func, len);
+	trec.function[len] = '\0';
+    }
+}
+
+/*
+ * callouts started later than they were scheduled for
+ */
+void Metrics::calloutLag(Uint msec, unsigned int count)
+{
+    if (mfile != (char *) NULL) {
+	colag.add(msec, count);
+    }
+}
+
+/*
+ * return the metrics slot for a port, or for an outbound connection if
+ * the port is negative
+ */
+int Metrics::port(int type, int port)
+{
+    int i;
+
+    if (port >= 0) {
+	for (i = 0; i < nports; i++) {
+	    if (ptype[i] == type) {
+		return i + port;
+	    }
+	}
+    }
+    return nports;
+}
+
+/*
+ * bytes received on a port
+ */
+void Metrics::input(int port, Uint n)
+{
+    if (mfile != (char *) NULL) {
+	pio[port].in += n;
+    }
+}
+
+/*
+ * bytes sent on a port
+ */
+void Metrics::output(int port, Uint n)
+{
+    if (mfile != (char *) NULL) {
+	pio[port].out += n;
+    }
+}
+
+/*
+ * write the metrics file, at most once per second
+ */
+void Metrics::report()
+{
+    static const char *types[] = { "telnet", "binary", "datagram" };
+    char buf[STRINGSZ], tmp[STRINGSZ + 4], *p;
+    Uint t;
+    int fd, i;
+
+    if (mfile == (char *) NULL || (t=P_time()) == mtime) {
+	return;
+    }
+    mtime = t;
+
+    p = path_native(buf, mfile);
+    sprintf(tmp, "%s.tmp", p);
+    fd = P_open(tmp, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY, 0644);
+    if (fd < 0) {
+	return;
+    }
+
+    {
+	Report r(fd);
+
+	tasktime.report(&r, "dgd_task_duration_seconds",
+			"Time from the start of a task to its end.", 1000000);
+	taskticks.report(&r, "dgd_task_ticks",
+			 "Ticks charged to the top level rlimits per task.", 1);
+	selwait.report(&r, "dgd_select_wait_seconds",
+		       "Time spent waiting for input or a timeout.", 1000000);
+	colag.report(&r, "dgd_callout_lag_seconds",
+		     "Time between when a callout was due and when it was "
+		     "collected.",
+		     1000);
+
+	r.printf("# HELP dgd_swap_misses_total "
+		 "Swap sectors not found in the cache.\n"
+		 "# TYPE dgd_swap_misses_total counter\n"
+		 "dgd_swap_misses_total %llu\n",
+		 (unsigned long long) swapMisses);
+	r.printf("# HELP dgd_swap_reads_total "
+		 "Sectors read from the swap file.\n"
+		 "# TYPE dgd_swap_reads_total counter\n"
+		 "dgd_swap_reads_total %llu\n",
+		 (unsigned long long) swapReads);
+	r.printf("# HELP dgd_swap_writes_total "
+		 "Sectors written to the swap file.\n"
+		 "# TYPE dgd_swap_writes_total counter\n"
+		 "dgd_swap_writes_total %llu\n",
+		 (unsigned long long) swapWrites);
+	r.printf("# HELP dgd_load_bytes_total Object bytes loaded from swap.\n"
+		 "# TYPE dgd_load_bytes_total counter\n"
+		 "dgd_load_bytes_total %llu\n",
+		 (unsigned long long) loadBytes);
+	r.printf("# HELP dgd_save_bytes_total Object bytes saved to swap.\n"
+		 "# TYPE dgd_save_bytes_total counter\n"
+		 "dgd_save_bytes_total %llu\n",
+		 (unsigned long long) saveBytes);
+	r.printf("# HELP dgd_dataspace_lookups_total "
+		 "Dataspace lookups, by whether the dataspace was in memory.\n"
+		 "# TYPE dgd_dataspace_lookups_total counter\n"
+		 "dgd_dataspace_lookups_total{result=\"hit\"} %llu\n"
+		 "dgd_dataspace_lookups_total{result=\"miss\"} %llu\n",
+		 (unsigned long long) dataHits,
+		 (unsigned long long) dataMisses);
+	r.printf("# HELP dgd_control_lookups_total "
+		 "Control block lookups, by whether the control block was in "
+		 "memory.\n"
+		 "# TYPE dgd_control_lookups_total counter\n"
+		 "dgd_control_lookups_total{result=\"hit\"} %llu\n"
+		 "dgd_control_lookups_total{result=\"miss\"} %llu\n",
+		 (unsigned long long) ctrlHits,
+		 (unsigned long long) ctrlMisses);
+
+	r.printf("# HELP dgd_port_received_bytes_total "
+		 "Bytes received per port.\n"
+		 "# TYPE dgd_port_received_bytes_total counter\n");
+	for (i = 0; i < nports; i++) {
+	    r.printf("dgd_port_received_bytes_total"
+		     "{type=\"%s\",port=\"%u\"} %llu\n",
+		     types[(int) ptype[i]], pnum[i],
+		     (unsigned long long) pio[i].in);
+	}
+	r.printf("dgd_port_received_bytes_total{type=\"outbound\"} %llu\n",
+		 (unsigned long long) pio[nports].in);
+	r.printf("# HELP dgd_port_sent_bytes_total Bytes sent per port.\n"
+		 "# TYPE dgd_port_sent_bytes_total counter\n");
+	for (i = 0; i < nports; i++) {
+	    r.printf("dgd_port_sent_bytes_total"
+		     "{type=\"%s\",port=\"%u\"} %llu\n",
+		     types[(int) ptype[i]], pnum[i],
+		     (unsigned long long) pio[i].out);
+	}
+	r.printf("dgd_port_sent_bytes_total{type=\"outbound\"} %llu\n",
+		 (unsigned long long) pio[nports].out);
+	r.flush();
+    }
+
+    P_close(fd);
+    P_rename(tmp, p);
+}
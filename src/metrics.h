@@ -0,0 +1,84 @@
+/*
+ * This file is part of DGD, https://github.com/dworkin/dgd
+ * Copyright (C) 1993-2010 Dworkin B.V.
+ * Copyright (C) 2010-2021 DGD Authors (see the commit log for details)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+# define MP_TELNET	0	/* telnet port */
+# define MP_BINARY	1	/* binary port */
+# define MP_DGRAM	2	/* datagram port */
+
+/* task phases */
+# define MT_INTERPRET	0	/* interpreting */
+# define MT_SWAPIN	1	/* loading objects from swap */
+# define MT_SWAPOUT	2	/* swapping out at the end of a task */
+# define MT_COMPILE	3	/* compiling */
+# define MT_XPORT	4	/* exporting values after a task */
+# define MT_FLUSH	5	/* flushing output */
+# define MT_NPHASES	6
+
+/* slow task ring file */
+# define TRACE_MAGIC	0x44474454	/* "DGDT" */
+# define TRACE_VERSION	1
+
+struct TraceHeader {
+    Uint magic;			/* TRACE_MAGIC */
+    Uint version;		/* TRACE_VERSION */
+    Uint size;			/* size of a record */
+    Uint nrecords;		/* # records in file */
+    Uint next;			/* next record to write */
+    Uint count;			/* # records written */
+};
+
+struct TraceRecord {
+    Uint time;			/* when the task ended */
+    Uint ticks;			/* ticks used */
+    Uuint duration;		/* task duration in microseconds */
+    Uuint phase[MT_NPHASES];	/* microseconds spent per phase */
+    Uuint mstart;		/* dynamic memory used at start */
+    Uuint mend;			/* dynamic memory used at end */
+    char object[STRINGSZ];	/* first object called */
+    char function[STRINGSZ];	/* first function called */
+};
+
+class Metrics {
+public:
+    static void init(char *file, unsigned short *tports, int ntports,
+		     unsigned short *bports, int nbports,
+		     unsigned short *dports, int ndports);
+    static void finish();
+    static void idle();
+    static void startTask();
+    static void endTask();
+    static void calloutLag(Uint msec, unsigned int count);
+    static int port(int type, int port);
+    static void input(int port, Uint n);
+    static void output(int port, Uint n);
+    static void report();
+    static void trace(char *file, Uint msec);
+    static int phase(int phase);
+    static void call(Object *obj, const char *func, unsigned int len);
+
+    static Uuint swapMisses;		/* swap slots not in cache */
+    static Uuint swapReads;		/* sectors read from swap file */
+    static Uuint swapWrites;		/* sectors written to swap file */
+    static Uuint loadBytes;		/* bytes read through swap cache */
+    static Uuint saveBytes;		/* bytes written through swap cache */
+    static Uuint dataHits;		/* dataspaces found in memory */
+    static Uuint dataMisses;		/* dataspaces loaded from swap */
+    static Uuint ctrlHits;		/* control blocks found in memory */
+    static Uuint ctrlMisses;		/* control blocks loaded from swap */
+};
@@ -27,6 +27,7 @@
 # include "data.h"
 # include "interpret.h"
 # include "ext.h"
+# include "metrics.h"
 
 
 class ObjPatch : public ChunkAllocated {
@@ -875,6 +876,7 @@ void Object::restoreObject(bool cactive, bool dactive)
 Control *Object::control()
 {
     Object *o;
+    int phase;
 
     o = this;
     if (!(o->flags & O_MASTER)) {
@@ -882,12 +884,23 @@ Control *Object::control()
 	o = OBJR(o->master);
     }
     if (o->ctrl == (Control *) NULL) {
-	if (BTST(omap, o->index)) {
-	    o->restoreObject(TRUE, FALSE);
-	} else {
-	    o->ctrl = Control::load(o, insttab[o->index]);
+	Metrics::ctrlMisses++;
+	phase = Metrics::phase(MT_SWAPIN);
+	try {
+	    EC->push();
+	    if (BTST(omap, o->index)) {
+		o->restoreObject(TRUE, FALSE);
+	    } else {
+		o->ctrl = Control::load(o, insttab[o->index]);
+	    }
+	    EC->pop();
+	} catch (...) {
+	    Metrics::phase(phase);
+	    EC->error((char *) NULL);
 	}
+	Metrics::phase(phase);
     } else {
+	Metrics::ctrlHits++;
 	o->ctrl->ref();
     }
     return ctrl = o->ctrl;
@@ -898,13 +911,26 @@ Control *Object::control()
  */
 Dataspace *Object::dataspace()
 {
+    int phase;
+
     if (data == (Dataspace *) NULL) {
-	if (BTST(omap, index)) {
-	    restoreObject(TRUE, TRUE);
-	} else {
-	    data = Dataspace::load(this);
+	Metrics::dataMisses++;
+	phase = Metrics::phase(MT_SWAPIN);
+	try {
+	    EC->push();
+	    if (BTST(omap, index)) {
+		restoreObject(TRUE, TRUE);
+	    } else {
+		data = Dataspace::load(this);
+	    }
+	    EC->pop();
+	} catch (...) {
+	    Metrics::phase(phase);
+	    EC->error((char *) NULL);
 	}
+	Metrics::phase(phase);
     } else {
+	Metrics::dataHits++;
 	data->ref();
     }
     return data;
@@ -285,6 +285,8 @@ RgxPosn *RgxPosn::create(Hashtab *htab, char *posn, unsigned short size,
     return rp;
 }
 
+# define PLUS_ENTERED	2	/* pattern+ entered but not yet matched */
+
 /*
  * convert a transition into a position
  */
@@ -309,25 +311,32 @@ bool RgxPosn::transposn(char *rgx, char *trans, char *buf,
 	for (p = trans; *p != '\0'; p++) {
 	    for (i = UCHAR(*p); ; i = place + 1) {
 		place = UCHAR(rgx[i]) + 1;
-		if (!a[place]) {
-		    a[place] = TRUE;
+		if (a[place] != TRUE) {
 		    if (place != UCHAR(rgx[0])) {
 			switch (rgx[place]) {
 			case '|':
 			    /* branch */
+			    a[place] = TRUE;
 			    b[n++] = place + 2;
 			    continue;
 
 			case '+':
 			    /* pattern+ */
-			    b[n++] = place + 2;
+			    if (!a[place]) {
+				b[n++] = place + 2;
+			    }
 			    if (place < i) {
+				/* repeated: may also leave */
+				a[place] = TRUE;
 				continue;
 			    }
+			    /* entered: must match the pattern first */
+			    a[place] = PLUS_ENTERED;
 			    break;
 
 			default:
 			    /* add to heap */
+			    a[place] = TRUE;
 			    for (i = ++len, j = i >> 1;
 				 UCHAR(heap[j]) > place;
 				 i = j, j >>= 1) {
@@ -336,6 +345,8 @@ bool RgxPosn::transposn(char *rgx, char *trans, char *buf,
 			    heap[i] = place;
 			    break;
 			}
+		    } else {
+			a[place] = TRUE;
 		    }
 		}
 		break;
@@ -356,11 +367,23 @@ bool RgxPosn::transposn(char *rgx, char *trans, char *buf,
 		    case '|':
 			/* branch */
 			q[n++] = place + 2;
-			q[n++] = UCHAR(rgx[place + 1]) + 1;
+			for (i = place + 1; ; i = j + 1) {
+			    j = UCHAR(rgx[i]) + 1;
+			    if (j > i || rgx[j] != '+' || a[j] == TRUE) {
+				break;
+			    }
+			    /* back to pattern+: may also leave */
+			    if (!a[j]) {
+				q[n++] = j + 2;
+			    }
+			    a[j] = TRUE;
+			}
+			q[n++] = j;
 			continue;
 
 		    case '+':
 			/* pattern+ */
+			a[place] = PLUS_ENTERED;
 			q[n++] = place + 2;
 			continue;
 		    }
@@ -837,7 +860,7 @@ char *DfaState::savetmp(char *sbuf, char **pbuf, char *pbase, Uint *ptab,
 }
 
 
-# define DFA_VERSION	1
+# define DFA_VERSION	2
 
 /*
  * construct a dfa instance
@@ -852,6 +875,7 @@ Dfa::Dfa(char *source, char *grammar)
     nsstrings = (UCHAR(grammar[9]) << 8) + UCHAR(grammar[10]);
     strings = grammar + 17 + (nregexp << 1);
     nposn = (UCHAR(grammar[7]) << 8) + UCHAR(grammar[8]);
+    nscan = 0;
 }
 
 /*
@@ -1540,6 +1564,7 @@ short Dfa::scan(String *str, ssizet *strlen, char **token, ssizet *len)
 	state = &states[1];
 	final = -1;
 	p = str->text + str->len - size;
+	nscan += size;
 
 	while (size != 0) {
 	    eclass = UCHAR(this->eclass[UCHAR(*p)]);
@@ -1595,6 +1620,7 @@ short Dfa::scan(String *str, ssizet *strlen, char **token, ssizet *len)
 		fsize = size;
 	    }
 	}
+	nscan -= size;
 
 	if (final >= 0) {
 	    if (nomatch != 0) {
@@ -1631,3 +1657,15 @@ short Dfa::scan(String *str, ssizet *strlen, char **token, ssizet *len)
 
     return DFA_EOS;
 }
+
+/*
+ * return the number of characters scanned since the previous call
+ */
+Uint Dfa::scanned()
+{
+    Uint n;
+
+    n = nscan;
+    nscan = 0;
+    return n;
+}
@@ -23,6 +23,7 @@ public:
 
     bool save(char **str, Uint *len);
     short scan(String *str, ssizet *strlen, char **token, ssizet *len);
+    Uint scanned();
 
     static Dfa *create(char *source, char *grammar);
     static Dfa *load(char *source, char *grammar, char *str, Uint len);
@@ -44,6 +45,7 @@ private:
     short whitespace;		/* whitespace rule or -1 */
     short nomatch;		/* nomatch rule or -1 */
 
+    Uint nscan;			/* # characters scanned */
     bool modified;		/* dfa modified */
     bool allocated;		/* dfa strings allocated locally */
     Uint dfasize;		/* size of state machine */
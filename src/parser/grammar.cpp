@@ -1082,3 +1082,56 @@ err:
     EC->error(buffer);
     return NULL;
 }
+
+# define RGXPREFIX	"match = /"
+# define RGXSUFFIX	"/ skip = nomatch S : match"
+
+/*
+ * turn a regular expression into the source of a grammar with a single
+ * token and a nomatch rule; the source is returned referenced
+ */
+String *Grammar::regexp(String *rgx)
+{
+    char buffer[STRINGSZ];
+    String *source;
+    ssizet len;
+    unsigned int buflen;
+
+    source = String::create((char *) NULL, (long) sizeof(RGXPREFIX) - 1 +
+					   rgx->len + sizeof(RGXSUFFIX) - 1);
+    memcpy(source->text, RGXPREFIX, sizeof(RGXPREFIX) - 1);
+    memcpy(source->text + sizeof(RGXPREFIX) - 1, rgx->text, rgx->len);
+    memcpy(source->text + sizeof(RGXPREFIX) - 1 + rgx->len, RGXSUFFIX,
+	   sizeof(RGXSUFFIX) - 1);
+    source->ref();
+
+    /* the regular expression must end at the / of the suffix */
+    len = source->len - (sizeof(RGXPREFIX) - 2);
+    switch (RgxNode::token(source, &len, buffer, &buflen)) {
+    case TOK_REGEXP:
+	if (len == sizeof(RGXSUFFIX) - 2) {
+	    return source;
+	}
+	/* fall through */
+    default:
+	source->del();
+	EC->error("Bad regular expression");
+
+    case TOK_TOOBIGRGX:
+	source->del();
+	EC->error("Regular expression too large");
+    }
+
+    return NULL;
+}
+
+/*
+ * check whether a grammar source was made from the given regular expression
+ */
+bool Grammar::sameRegexp(String *source, String *rgx)
+{
+    return (source->len == sizeof(RGXPREFIX) - 1 + rgx->len +
+			   sizeof(RGXSUFFIX) - 1 &&
+	    memcmp(source->text + sizeof(RGXPREFIX) - 1, rgx->text,
+		   rgx->len) == 0);
+}
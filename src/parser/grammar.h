@@ -22,6 +22,8 @@
 class Grammar {
 public:
     static String *parse(String *gram);
+    static String *regexp(String *rgx);
+    static bool sameRegexp(String *source, String *rgx);
 
 private:
     static String *create(class Rule *rgxlist, Rule *strlist, Rule *estrlist,
@@ -925,3 +925,190 @@ Array *Parser::parse_string(Frame *f, String *source, String *str, Int maxalt)
 
     return a;
 }
+
+
+/*
+ * Regular expressions are matched with the same lazily constructed DFA
+ * as the tokens of parse_string().  Each one is turned into a grammar
+ * with a single token and a nomatch rule, so that scanning a string
+ * alternates between text that does not match and the leftmost longest
+ * match.  Recently used expressions are kept in a small cache.
+ */
+
+static Regexp *rxtab[RGXTABSZ];		/* regular expression cache */
+
+/*
+ * delete a regular expression
+ */
+Regexp::~Regexp()
+{
+    *slot = (Regexp *) NULL;
+    source->del();
+    grammar->del();
+    delete fa;
+}
+
+/*
+ * find a regular expression in the cache, or compile it
+ */
+Regexp *Regexp::find(String *rgx)
+{
+    Regexp **slot, *rx;
+    String *source, *grammar;
+
+    slot = &rxtab[Hashtab::hashkey(rgx->text, rgx->len) % RGXTABSZ];
+    if (*slot != (Regexp *) NULL &&
+	Grammar::sameRegexp((*slot)->source, rgx)) {
+	return *slot;
+    }
+
+    source = Grammar::regexp(rgx);
+    try {
+	EC->push();
+	grammar = Grammar::parse(source);
+	EC->pop();
+    } catch (...) {
+	source->del();
+	EC->error((char *) NULL);	/* pass on error */
+    }
+    if (*slot != (Regexp *) NULL) {
+	delete *slot;
+    }
+
+    rx = *slot = new Regexp;
+    rx->slot = slot;
+    rx->source = source;
+    rx->grammar = grammar;
+    grammar->ref();
+    rx->fa = Dfa::create(source->text, grammar->text);
+    rx->nomatch = (UCHAR(grammar->text[3]) << 8) + UCHAR(grammar->text[4]);
+    return rx;
+}
+
+/*
+ * scan for the next token, charging a tick per character examined
+ */
+short Regexp::scan(Frame *f, String *str, ssizet *size, char **text,
+		   ssizet *len)
+{
+    short token;
+
+    token = fa->scan(str, size, text, len);
+    i_add_ticks(f, fa->scanned());
+    return token;
+}
+
+/*
+ * find the first match at or after offset, and return its range
+ */
+Array *Regexp::match(Frame *f, String *rgx, String *str, Int offset)
+{
+    Regexp *rx;
+    ssizet size, len;
+    char *text;
+    short token;
+    Array *a;
+
+    rx = find(rgx);
+    size = str->len - offset;
+    do {
+	token = rx->scan(f, str, &size, &text, &len);
+    } while (token == rx->nomatch);
+
+    if (token == DFA_EOS) {
+	return (Array *) NULL;
+    } else if (token == DFA_TOOBIG) {
+	delete rx;
+	EC->error("Regular expression too complex");
+    }
+
+    a = Array::create(f->data, 2);
+    PUT_INTVAL(&a->elts[0], text - str->text);
+    PUT_INTVAL(&a->elts[1], text - str->text + len - 1);
+    return a;
+}
+
+/*
+ * split a string at the matches of a regular expression
+ */
+Array *Regexp::split(Frame *f, String *rgx, String *str)
+{
+    Regexp *rx;
+    ssizet size, len, start, *pieces;
+    Uint n, npieces;
+    char *text;
+    short token;
+    Array *a;
+    Value *v;
+
+    rx = find(rgx);
+    pieces = ALLOC(ssizet, npieces = 16);
+    n = 0;
+    start = 0;
+    size = str->len;
+    for (;;) {
+	token = rx->scan(f, str, &size, &text, &len);
+	if (token == rx->nomatch) {
+	    continue;
+	}
+	if (token < 0) {
+	    break;
+	}
+
+	if (text != str->text) {
+	    /* text before this match, unless the match is leading */
+	    if (n == npieces) {
+		pieces = REALLOC(pieces, ssizet, npieces, npieces << 1);
+		npieces <<= 1;
+	    }
+	    pieces[n++] = start;
+	    pieces[n++] = text - str->text;
+	}
+	start = text - str->text + len;
+    }
+    if (token == DFA_TOOBIG) {
+	FREE(pieces);
+	delete rx;
+	EC->error("Regular expression too complex");
+    }
+    if (start != str->len) {
+	/* text after the last match */
+	if (n == npieces) {
+	    pieces = REALLOC(pieces, ssizet, npieces, npieces << 1);
+	    npieces <<= 1;
+	}
+	pieces[n++] = start;
+	pieces[n++] = str->len;
+    }
+
+    try {
+	EC->push();
+	a = Array::create(f->data, n >> 1);
+	EC->pop();
+    } catch (...) {
+	FREE(pieces);
+	EC->error((char *) NULL);	/* pass on error */
+    }
+    for (v = a->elts, npieces = 0; npieces < n; v++, npieces += 2) {
+	PUT_STRVAL(v, String::create(str->text + pieces[npieces],
+				     pieces[npieces + 1] - pieces[npieces]));
+    }
+    FREE(pieces);
+    i_add_ticks(f, (Int) 2 * a->size);
+
+    return a;
+}
+
+/*
+ * remove all cached regular expressions
+ */
+void Regexp::clear()
+{
+    Regexp **r;
+
+    for (r = rxtab; r < rxtab + RGXTABSZ; r++) {
+	if (*r != (Regexp *) NULL) {
+	    delete *r;
+	}
+    }
+}
@@ -66,3 +66,24 @@ private:
 
     Int maxalt;			/* max number of branches */
 };
+
+class Regexp : public Allocated {
+public:
+    virtual ~Regexp();
+
+    static Array *match(Frame *f, String *rgx, String *str, Int offset);
+    static Array *split(Frame *f, String *rgx, String *str);
+    static void clear();
+
+private:
+    short scan(Frame *f, String *str, ssizet *size, char **text,
+	       ssizet *len);
+
+    static Regexp *find(String *rgx);
+
+    String *source;		/* grammar source */
+    String *grammar;		/* preprocessed grammar */
+    class Dfa *fa;		/* (partial) DFA */
+    short nomatch;		/* nomatch token */
+    Regexp **slot;		/* entry in cache */
+};
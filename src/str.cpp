@@ -30,35 +30,54 @@ struct StrHash : public Hashtab::Entry, public ChunkAllocated {
     Uint index;			/* building index */
 };
 
+/*
+ * allocator for long strings, which have their text in the same block
+ */
+class StrAllocator : public ChunkAllocator {
+public:
+    size_t size;		/* text size of the next string */
+
+private:
+    virtual Header *alloc() {
+	return (Header *) ALLOC(char, sizeof(Header) + sizeof(String) -
+				      STR_INLINE + size + 1);
+    }
+
+    virtual void del(Header *ptr) {
+	FREE(ptr);
+    }
+};
+
 static Chunk<String, STR_CHUNK> schunk;
+static StrAllocator lchunk;
 static Chunk<StrHash, STR_CHUNK> hchunk;
 
 static Hashtab *sht;		/* string merge table */
 
 
-String::String(const char *text, long len)
+String::String(const char *text, long len, long size)
 {
-    this->text = ALLOC(char, len + 1);
     if (text != (char *) NULL && len > 0) {
 	memcpy(this->text, text, (unsigned int) len);
     }
     this->text[this->len = len] = '\0';
+    this->size = size;
     refCount = 0;
     primary = (StrRef *) NULL;
 }
 
-String::~String()
-{
-    FREE(text);
-}
-
 /*
  * Create a new string. The text can be a NULL pointer, in which case it must
- * be filled in later.
+ * be filled in later.  Short strings are kept in the chunked string header,
+ * longer ones get a single block that holds both header and text.
  */
 String *String::alloc(const char *text, long len)
 {
-    return chunknew (schunk) String(text, len);
+    if (len < STR_INLINE) {
+	return chunknew (schunk) String(text, len, STR_INLINE - 1);
+    }
+    lchunk.size = len;
+    return chunknew (lchunk) String(text, len, len);
 }
 
 /*
@@ -195,6 +214,40 @@ String *String::add(String *str)
     return s;
 }
 
+/*
+ * Append a string in place, growing the text geometrically; only to be used
+ * on a string which is referenced solely by the caller.  If the string has
+ * to be moved, the new string is returned and the old one is deleted.
+ */
+String *String::append(String *str)
+{
+    String *s;
+    long l, sz;
+
+    l = (long) len + str->len;
+    if (l > (unsigned long) MAX_STRLEN) {
+	EC->error("String too long");
+    }
+    if (l > size) {
+	sz = (long) size << 1;
+	if (sz < l) {
+	    sz = l;
+	} else if (sz > (unsigned long) MAX_STRLEN) {
+	    sz = MAX_STRLEN;
+	}
+	lchunk.size = sz;
+	s = chunknew (lchunk) String(text, len, sz);
+	s->refCount = refCount;
+	delete this;
+    } else {
+	s = this;
+    }
+    memcpy(s->text + s->len, str->text, str->len);
+    s->text[s->len = l] = '\0';
+
+    return s;
+}
+
 /*
  * index a string
  */
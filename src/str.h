@@ -17,13 +17,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+# define STR_INLINE	32	/* text size of short strings */
+
 class String : public ChunkAllocated {
 public:
-    ~String();
     void ref() { refCount++; }
     void del();
     int cmp(String *str);
     String *add(String *str);
+    String *append(String *str);
     ssizet index(long idx);
     void checkRange(long from, long to);
     String *range(long from, long to);
@@ -38,8 +40,12 @@ public:
     struct StrRef *primary;	/* primary reference */
     Uint refCount;		/* number of references */
     ssizet len;			/* string length */
-    char *text;			/* string text */
 
 private:
-    String(const char *text, long length);
+    String(const char *text, long length, long size);
+
+    ssizet size;		/* allocated text size, excluding '\0' */
+
+public:
+    char text[STR_INLINE];	/* string text, longer for long strings */
 };
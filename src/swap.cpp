@@ -21,6 +21,7 @@
 # include "dgd.h"
 # include "hash.h"
 # include "swap.h"
+# include "metrics.h"
 
 static char *swapfile;			/* swap file name */
 static int swap;			/* swap file descriptor */
@@ -41,6 +42,11 @@ static Sector nfree;			/* # free sectors */
 static Sector ssectors;			/* sectors actually in swap file */
 static Sector sbarrier;			/* swap sector barrier */
 static bool swapping;			/* currently using a swapfile? */
+static Sector *dmap;			/* sector map in last snapshot */
+static Sector dsectors;			/* # sectors in last snapshot */
+static Sector *mpages;			/* sector map pages in snapshot */
+static Uint *msums;			/* sector map page checksums */
+static Uint crctab[256];		/* CRC-32 table */
 
 /*
  * initialize the swap device
@@ -50,6 +56,8 @@ void Swap::init(char *file, unsigned int total, unsigned int cache,
 {
     SwapSlot *h;
     Sector i;
+    Uint crc;
+    int j;
 
     /* allocate and initialize all tables */
     swapfile = file;
@@ -62,6 +70,20 @@ void Swap::init(char *file, unsigned int total, unsigned int cache,
     smap = ALLOC(Sector, total);
     cbuf = ALLOC(char, secsize);
     cached = SW_UNUSED;
+    dmap = ALLOC(Sector, total);
+    i = (total + secsize / sizeof(Sector) - 1) / (secsize / sizeof(Sector));
+    mpages = ALLOC(Sector, i);
+    msums = ALLOC(Uint, i);
+    dsectors = 0;
+
+    /* CRC-32 table for sector map pages */
+    for (i = 0; i < 256; i++) {
+	crc = i;
+	for (j = 8; j > 0; --j) {
+	    crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320L : crc >> 1;
+	}
+	crctab[i] = crc;
+    }
 
     /* 0 sectors allocated */
     nsectors = 0;
@@ -309,6 +331,7 @@ Swap::SwapSlot *Swap::load(Sector sec, bool restore, bool fill)
 	/*
 	 * the sector is either unused or in the swap file
 	 */
+	Metrics::swapMisses++;
 	if (lfree != (SwapSlot *) NULL) {
 	    /*
 	     * get swap slot from the free swap slot list
@@ -356,6 +379,7 @@ Swap::SwapSlot *Swap::load(Sector sec, bool restore, bool fill)
 		if (!write(swap, h + 1, sectorsize)) {
 		    EC->fatal("cannot write swap file");
 		}
+		Metrics::swapWrites++;
 	    }
 	    map[h->sec] = save;
 	}
@@ -384,6 +408,7 @@ Swap::SwapSlot *Swap::load(Sector sec, bool restore, bool fill)
 		if (P_read(swap, (char *) (h + 1), sectorsize) <= 0) {
 		    EC->fatal("cannot read swap file");
 		}
+		Metrics::swapReads++;
 	    }
 	} else if (fill) {
 	    /* zero-fill new sector */
@@ -429,6 +454,7 @@ void Swap::readv(char *m, Sector *vec, Uint size, Uint idx)
 {
     unsigned int len;
 
+    Metrics::loadBytes += size;
     vec += idx / sectorsize;
     idx %= sectorsize;
     do {
@@ -447,6 +473,7 @@ void Swap::writev(char *m, Sector *vec, Uint size, Uint idx)
     SwapSlot *h;
     unsigned int len;
 
+    Metrics::saveBytes += size;
     vec += idx / sectorsize;
     idx %= sectorsize;
     do {
@@ -689,6 +716,105 @@ char *Swap::decompress(Sector *sectors,
     }
 }
 
+/*
+ * compute the CRC-32 checksum of a buffer
+ */
+Uint Swap::checksum(char *buf, unsigned int size)
+{
+    Uint crc;
+
+    crc = 0xffffffffL;
+    while (size != 0) {
+	crc = (crc >> 8) ^ crctab[UCHAR(crc ^ *buf++)];
+	--size;
+    }
+    return crc ^ 0xffffffffL;
+}
+
+/*
+ * Write the sector map as a series of checksummed pages, followed by the
+ * table of pages.  Pages that did not change since the previous snapshot
+ * in the same file are not written again.
+ */
+void Swap::savemap(bool reuse)
+{
+    Sector i, n, entries, npages, dpages;
+    Sector *m;
+
+    entries = sectorsize / sizeof(Sector);
+    npages = (nsectors + entries - 1) / entries;
+    dpages = (reuse) ? (dsectors + entries - 1) / entries : 0;
+    cached = SW_UNUSED;
+
+    for (i = 0, m = map; i < npages; i++, m += entries) {
+	n = (i == npages - 1) ? nsectors - i * entries : entries;
+	if (i < dpages &&
+	    n == ((i == dpages - 1) ? dsectors - i * entries : entries) &&
+	    memcmp(m, dmap + i * entries, n * sizeof(Sector)) == 0) {
+	    continue;	/* unchanged */
+	}
+
+	/*
+	 * write a new page beyond the swap sectors
+	 */
+	if (ssectors == SW_UNUSED) {
+	    EC->fatal("out of sectors");
+	}
+	memset(cbuf, '\0', sectorsize);
+	memcpy(cbuf, m, n * sizeof(Sector));
+	memcpy(dmap + i * entries, m, n * sizeof(Sector));
+	mpages[i] = ssectors++;
+	msums[i] = checksum(cbuf, sectorsize);
+	P_lseek(swap, (off_t) (mpages[i] + 1L) * sectorsize, SEEK_SET);
+	if (!write(swap, cbuf, sectorsize)) {
+	    EC->fatal("cannot write sector map to snapshot");
+	}
+    }
+    dsectors = nsectors;
+
+    /* write table of pages */
+    P_lseek(swap, (off_t) (ssectors + 1L) * sectorsize, SEEK_SET);
+    if (!write(swap, mpages, npages * sizeof(Sector)) ||
+	!write(swap, msums, npages * sizeof(Uint))) {
+	EC->fatal("cannot write sector map to snapshot");
+    }
+}
+
+/*
+ * restore the sector map from checksummed pages
+ */
+void Swap::restoremap(int fd, unsigned int secsize, Sector n)
+{
+    Sector i, entries, npages, *pages;
+    Uint *sums;
+    char *buf;
+    off_t posn;
+
+    entries = secsize / (Config::dsize("d") & 0xff);
+    npages = (n + entries - 1) / entries;
+    pages = ALLOC(Sector, npages + 1);
+    sums = ALLOC(Uint, npages + 1);
+    Config::dread(fd, (char *) pages, "d", (Uint) npages);
+    Config::dread(fd, (char *) sums, "i", (Uint) npages);
+    posn = P_lseek(fd, 0, SEEK_CUR);
+
+    buf = ALLOC(char, secsize);
+    for (i = 0; i < npages; i++) {
+	P_lseek(fd, (off_t) (pages[i] + 1L) * secsize, SEEK_SET);
+	if (P_read(fd, buf, secsize) != secsize ||
+	    checksum(buf, secsize) != sums[i]) {
+	    EC->error("Corrupted sector map in snapshot");
+	}
+	Config::dconv((char *) (map + i * entries), buf, "d",
+		      (i == npages - 1) ? n - i * entries : entries);
+    }
+    FREE(buf);
+    FREE(sums);
+    FREE(pages);
+
+    P_lseek(fd, posn, SEEK_SET);
+}
+
 /*
  * return the number of sectors presently in use
  */
@@ -717,7 +843,10 @@ int Swap::save(char *snapshot, bool keep)
     Sector sec;
     char buffer[STRINGSZ + 4], buf1[STRINGSZ], buf2[STRINGSZ], *p, *q;
     Sector n;
+    bool reuse;
 
+    /* map pages can only be shared with a snapshot in the same file */
+    reuse = !swapping;
     if (swap < 0) {
 	create();
     }
@@ -809,10 +938,7 @@ int Swap::save(char *snapshot, bool keep)
     }
 
     /* write map */
-    P_lseek(swap, (off_t) (ssectors + 1L) * sectorsize, SEEK_SET);
-    if (!write(swap, map, nsectors * sizeof(Sector))) {
-	EC->fatal("cannot write sector map to snapshot");
-    }
+    savemap(reuse);
 
     /* fix the sector map */
     for (h = last; h != (SwapSlot *) NULL; h = h->prev) {
@@ -904,7 +1030,7 @@ void Swap::save2(SnapshotInfo *header, int size, bool incr)
 /*
  * restore snapshot
  */
-void Swap::restore(int fd, unsigned int secsize)
+void Swap::restore(int fd, unsigned int secsize, bool conv_17)
 {
     DumpHeader dh;
 
@@ -926,7 +1052,11 @@ void Swap::restore(int fd, unsigned int secsize)
     P_lseek(fd, (off_t) (dh.ssectors + 1L) * secsize, SEEK_SET);
 
     /* restore swap map */
-    Config::dread(fd, (char *) map, "d", (Uint) dh.nsectors);
+    if (conv_17) {
+	Config::dread(fd, (char *) map, "d", (Uint) dh.nsectors);
+    } else {
+	restoremap(fd, secsize, dh.nsectors);
+    }
     nsectors = dh.nsectors;
     mfree = dh.mfree;
     nfree = dh.nfree;
@@ -49,12 +49,15 @@ public:
     static bool copy(Uint);
     static int save(char*, bool);
     static void save2(SnapshotInfo*, int, bool);
-    static void restore(int, unsigned int);
+    static void restore(int, unsigned int, bool);
     static void restore2(int);
 
 private:
     static void create();
     static Sector mapsize(unsigned int);
+    static Uint checksum(char *buf, unsigned int size);
+    static void savemap(bool reuse);
+    static void restoremap(int fd, unsigned int secsize, Sector n);
     static void newv(Sector *vec, unsigned int size);
     static SwapSlot *load(Sector sec, bool restore, bool fill);
 };